@@ -0,0 +1,155 @@
+#ifndef __GPIOCHIP_H__
+#define __GPIOCHIP_H__
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// system headers
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+namespace gpio {
+
+  // Raspberry Pi header GPIOs are lines of the first chip, numbered like BCM pins
+  constexpr const char* DEFAULT_CHIP = "/dev/gpiochip0";
+
+  enum class Edge : uint8_t {
+    Rising,
+    Falling,
+    Both,
+  };
+
+  enum class Bias : uint8_t {
+    None,
+    PullUp,
+    PullDown,
+  };
+
+  struct Event {
+    uint64_t timestampNs;   // CLOCK_MONOTONIC time the kernel saw the edge
+    uint32_t line;          // line offset on the chip (the BCM number on a Pi)
+    bool rising;
+    uint32_t seqno;         // per-request sequence number, gaps mean the kernel buffer overflowed
+  };
+
+  // A set of input lines requested through the GPIO v2 character device uAPI
+  // Edges are queued by the kernel with their timestamp and read from fd(), which goes into the main loop;
+  // no thread per pin, and debouncing happens in the kernel (debounce_period_us)
+  class Lines {
+    private:
+      int m_fd = -1;
+      std::vector<uint32_t> m_offsets;
+
+    public:
+
+      Lines(const std::string& chip, std::initializer_list<uint32_t> offsets, Edge edge, Bias bias,
+            std::chrono::microseconds debounce, const char* consumer = "thermostat")
+        : m_offsets(offsets) {
+        if (m_offsets.empty() || m_offsets.size() > GPIO_V2_LINES_MAX) {
+          throw std::invalid_argument("Invalid number of GPIO lines");
+        }
+
+        int chipFd = open(chip.c_str(), O_RDWR | O_CLOEXEC);
+        if (chipFd < 0) {
+          throw std::runtime_error(std::string("Could not open ") + chip);
+        }
+
+        gpio_v2_line_request request;
+        std::memset(&request, 0, sizeof(request));
+        for (size_t i = 0; i < m_offsets.size(); i++) {
+          request.offsets[i] = m_offsets[i];
+        }
+        request.num_lines = m_offsets.size();
+        std::strncpy(request.consumer, consumer, sizeof(request.consumer) - 1);
+        // Room for a burst on every line before edges get dropped
+        request.event_buffer_size = 16 * m_offsets.size();
+
+        uint64_t flags = GPIO_V2_LINE_FLAG_INPUT;
+        if (edge != Edge::Falling) {
+          flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+        }
+        if (edge != Edge::Rising) {
+          flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        }
+        if (bias == Bias::PullUp) {
+          flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+        } else if (bias == Bias::PullDown) {
+          flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
+        }
+        request.config.flags = flags;
+
+        if (debounce.count() > 0) {
+          gpio_v2_line_config_attribute& attribute = request.config.attrs[0];
+          attribute.attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+          attribute.attr.debounce_period_us = debounce.count();
+          attribute.mask = (m_offsets.size() == 64) ? ~0ULL : ((1ULL << m_offsets.size()) - 1);
+          request.config.num_attrs = 1;
+        }
+
+        int result = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request);
+        close(chipFd);
+        if (result < 0) {
+          throw std::runtime_error(std::string("Could not request lines on ") + chip);
+        }
+        m_fd = request.fd;
+        // Non-blocking so the loop can drain every queued edge
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+      }
+
+      Lines(const Lines&) = delete;
+      Lines& operator=(const Lines&) = delete;
+
+      Lines(Lines&& other) noexcept : m_fd(std::exchange(other.m_fd, -1)), m_offsets(std::move(other.m_offsets)) {}
+
+      // Readable when edge events are queued
+      int fd() const {
+        return m_fd;
+      }
+
+      // Reads one queued edge, returns false if there is none
+      bool read(Event& event) {
+        gpio_v2_line_event raw;
+        if (::read(m_fd, &raw, sizeof(raw)) != sizeof(raw)) {
+          return false;
+        }
+        event.timestampNs = raw.timestamp_ns;
+        event.line = raw.offset;
+        event.rising = raw.id == GPIO_V2_LINE_EVENT_RISING_EDGE;
+        event.seqno = raw.seqno;
+        return true;
+      }
+
+      // Current level of a requested line (1 high, 0 low), or -1 on error
+      int value(uint32_t offset) const {
+        for (size_t i = 0; i < m_offsets.size(); i++) {
+          if (m_offsets[i] != offset) {
+            continue;
+          }
+          gpio_v2_line_values values = {};
+          values.mask = 1ULL << i;
+          if (ioctl(m_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+            return -1;
+          }
+          return (values.bits >> i) & 1;
+        }
+        return -1;
+      }
+
+      ~Lines() {
+        if (m_fd >= 0) {
+          close(m_fd);
+          m_fd = -1;
+        }
+      }
+  };
+}
+
+#endif // __GPIOCHIP_H__
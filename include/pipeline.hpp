@@ -0,0 +1,209 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "reactor.hpp"
+#include "samples.hpp"
+#include "timing.hpp"
+
+namespace pipeline {
+
+  // Latency counters, written by one thread and readable from any
+  // A reader may see count and total from slightly different moments, which only matters for mean()
+  class Latency {
+    private:
+      std::atomic<uint64_t> m_count{0};
+      std::atomic<uint64_t> m_totalNs{0};
+      std::atomic<uint64_t> m_lastNs{0};
+      std::atomic<uint64_t> m_maxNs{0};
+
+    public:
+
+      // Writer only
+      void record(std::chrono::nanoseconds elapsed) {
+        uint64_t ns = elapsed.count() > 0 ? elapsed.count() : 0;
+        m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_totalNs.store(m_totalNs.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        m_lastNs.store(ns, std::memory_order_relaxed);
+        if (ns > m_maxNs.load(std::memory_order_relaxed)) {
+          m_maxNs.store(ns, std::memory_order_relaxed);
+        }
+      }
+
+      uint64_t count() const {
+        return m_count.load(std::memory_order_relaxed);
+      }
+
+      std::chrono::nanoseconds last() const {
+        return std::chrono::nanoseconds(m_lastNs.load(std::memory_order_relaxed));
+      }
+
+      std::chrono::nanoseconds max() const {
+        return std::chrono::nanoseconds(m_maxNs.load(std::memory_order_relaxed));
+      }
+
+      std::chrono::nanoseconds mean() const {
+        uint64_t count = m_count.load(std::memory_order_relaxed);
+        return std::chrono::nanoseconds(count > 0 ? m_totalNs.load(std::memory_order_relaxed) / count : 0);
+      }
+  };
+
+  // A consumer thread on a sample ring
+  // notify() wakes it; it then drains every sample published since its last pass, one onSample call each,
+  // and finishes with one onBatch call. The producer never waits for a stage: one that falls more than the
+  // ring's capacity behind loses the oldest samples (dropped()), so a slow stage cannot hold up the others
+  // Latencies run from a sample's publishedNs (its monotonicNs when that is 0) and are taken on Clock, which
+  // must be the clock the samples were stamped with
+  // setMinInterval() caps the pass rate: a notify() too soon after the last pass is held back until the interval
+  // is over, and everything that arrives meanwhile is folded into that one pass
+  template <size_t Capacity, typename Clock = timing::Monotonic>
+  class Stage {
+    public:
+      using SampleHandler = std::function<void(const samples::Sample&)>;
+      using BatchHandler = std::function<void()>;
+
+    private:
+      const samples::Ring<Capacity>& m_ring;
+      samples::Reader m_reader;
+      SampleHandler m_onSample;
+      BatchHandler m_onBatch;
+      event::Loop m_loop;
+      event::Notifier m_wake;
+      std::atomic<bool> m_stopping{false};
+
+      // Rate cap, on the real monotonic clock whatever Clock is
+      event::Timer m_holdoff;
+      std::atomic<int64_t> m_minIntervalNs{0};
+      timing::Monotonic::time_point m_lastPass{};
+      bool m_held = false;
+      std::atomic<uint64_t> m_heldPasses{0};
+
+      // Mirrors of the reader, for the counters
+      std::atomic<uint64_t> m_position{0};
+      std::atomic<uint64_t> m_dropped{0};
+      std::atomic<uint64_t> m_processed{0};
+      Latency m_latency;    // sample published to the stage picking it up
+      Latency m_service;    // one pass: draining plus onBatch
+
+      // Started last, once everything it uses is constructed
+      std::thread m_thread;
+
+      void drain() {
+        auto start = Clock::now();
+        samples::Sample sample;
+        samples::ReadResult result;
+        while ((result = m_ring.read(m_reader, sample)) != samples::ReadResult::Empty) {
+          if (result != samples::ReadResult::Ok) {
+            continue;
+          }
+          uint64_t now = timing::nowNanos<Clock>();
+          uint64_t published = sample.publishedNs != 0 ? sample.publishedNs : sample.monotonicNs;
+          m_latency.record(std::chrono::nanoseconds(static_cast<int64_t>(now - published)));
+          m_onSample(sample);
+          m_processed.store(m_processed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        m_position.store(m_reader.next, std::memory_order_relaxed);
+        m_dropped.store(m_reader.dropped, std::memory_order_relaxed);
+
+        m_onBatch();
+        m_service.record(Clock::now() - start);
+      }
+
+      void pass() {
+        auto now = timing::Monotonic::now();
+        auto wait = std::chrono::nanoseconds(m_minIntervalNs.load(std::memory_order_relaxed)) - (now - m_lastPass);
+        if (wait > std::chrono::nanoseconds(0)) {
+          if (!m_held) {
+            m_held = true;
+            m_heldPasses.store(m_heldPasses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            m_holdoff.set(wait, std::chrono::nanoseconds(0));
+          }
+          return;
+        }
+        m_lastPass = now;
+        drain();
+      }
+
+    public:
+
+      // Starts with the next sample pushed to ring
+      Stage(const samples::Ring<Capacity>& ring, SampleHandler onSample, BatchHandler onBatch)
+        : m_ring(ring), m_reader(ring.reader()), m_onSample(std::move(onSample)), m_onBatch(std::move(onBatch)) {
+        m_position.store(m_reader.next, std::memory_order_relaxed);
+        m_loop.add(m_wake.fd(), EPOLLIN, [this](uint32_t) {
+          m_wake.consume();
+          if (m_stopping.load(std::memory_order_acquire)) {
+            m_loop.stop();
+            return;
+          }
+          if (!m_held) {
+            pass();
+          }
+        });
+        m_loop.add(m_holdoff.fd(), EPOLLIN, [this](uint32_t) {
+          m_holdoff.consume();
+          m_held = false;
+          pass();
+        });
+        m_thread = std::thread([this] { m_loop.run(); });
+      }
+
+      Stage(const Stage&) = delete;
+      Stage& operator=(const Stage&) = delete;
+
+      // Thread-safe; wakeups that arrive during a pass are folded into one more pass
+      void notify() {
+        m_wake.notify();
+      }
+
+      // Samples published but not picked up yet, at most the ring's capacity
+      uint64_t depth() const {
+        uint64_t behind = m_ring.published() - m_position.load(std::memory_order_relaxed);
+        return std::min<uint64_t>(behind, Capacity);
+      }
+
+      // Thread-safe, takes effect from the next pass; 0 (the default) runs a pass on every wakeup
+      void setMinInterval(std::chrono::nanoseconds interval) {
+        m_minIntervalNs.store(interval.count(), std::memory_order_relaxed);
+      }
+
+      // Passes that were held back by the rate cap
+      uint64_t held() const {
+        return m_heldPasses.load(std::memory_order_relaxed);
+      }
+
+      uint64_t processed() const {
+        return m_processed.load(std::memory_order_relaxed);
+      }
+
+      uint64_t dropped() const {
+        return m_dropped.load(std::memory_order_relaxed);
+      }
+
+      const Latency& latency() const {
+        return m_latency;
+      }
+
+      const Latency& service() const {
+        return m_service;
+      }
+
+      uint64_t wakeups() const {
+        return m_loop.wakeups();
+      }
+
+      ~Stage() {
+        m_stopping.store(true, std::memory_order_release);
+        m_wake.notify();
+        m_thread.join();
+      }
+  };
+}
+
+#endif // __PIPELINE_H__
@@ -0,0 +1,273 @@
+#ifndef __REACTOR_H__
+#define __REACTOR_H__
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+// system headers
+#include <unistd.h>
+#include <csignal>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "timing.hpp"
+
+namespace event {
+
+  // epoll based event loop: the process sleeps in epoll_wait until one of its fds is ready
+  class Loop {
+    public:
+      using Callback = std::function<void(uint32_t events)>;
+
+    private:
+      int m_epoll = -1;
+      std::map<int, Callback> m_handlers;
+      std::atomic<uint64_t> m_wakeups{0};
+      bool m_running = false;
+
+    public:
+
+      Loop() {
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (m_epoll < 0) {
+          throw std::runtime_error("Could not create epoll instance");
+        }
+      }
+
+      Loop(const Loop&) = delete;
+      Loop& operator=(const Loop&) = delete;
+
+      // Calls callback with the ready events (EPOLLIN, ...) whenever fd becomes ready
+      void add(int fd, uint32_t events, Callback callback) {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) < 0) {
+          throw std::runtime_error(std::string("Could not watch fd ") + std::to_string(fd));
+        }
+        m_handlers[fd] = std::move(callback);
+      }
+
+      void remove(int fd) {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+        m_handlers.erase(fd);
+      }
+
+      // Waits up to timeoutMs (-1 forever) and dispatches what is ready, returns the number of events handled
+      int runOnce(int timeoutMs = -1) {
+        epoll_event events[16];
+        int n = epoll_wait(m_epoll, events, 16, timeoutMs);
+        if (n < 0) {
+          return errno == EINTR ? 0 : -errno;
+        }
+        m_wakeups.fetch_add(1, std::memory_order_relaxed);
+        for (int i = 0; i < n; i++) {
+          auto handler = m_handlers.find(events[i].data.fd);
+          if (handler != m_handlers.end()) {
+            handler->second(events[i].events);
+          }
+        }
+        return n;
+      }
+
+      // Dispatches events until stop() is called from a callback
+      void run() {
+        m_running = true;
+        while (m_running) {
+          if (runOnce() < 0) {
+            throw std::runtime_error("epoll_wait failed");
+          }
+        }
+      }
+
+      void stop() {
+        m_running = false;
+      }
+
+      // Number of times the loop woke up, for power measurements; readable from any thread
+      uint64_t wakeups() const {
+        return m_wakeups.load(std::memory_order_relaxed);
+      }
+
+      ~Loop() {
+        if (m_epoll >= 0) {
+          close(m_epoll);
+          m_epoll = -1;
+        }
+      }
+  };
+
+  // Periodic CLOCK_MONOTONIC timer, readable once per elapsed period
+  class Timer {
+    private:
+      int m_fd = -1;
+
+    public:
+
+      Timer() {
+        m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (m_fd < 0) {
+          throw std::runtime_error("Could not create timerfd");
+        }
+      }
+
+      Timer(const Timer&) = delete;
+      Timer& operator=(const Timer&) = delete;
+
+      int fd() const {
+        return m_fd;
+      }
+
+      // Fires after initial and then every period (a zero period makes it one-shot)
+      void set(std::chrono::nanoseconds initial, std::chrono::nanoseconds period) {
+        itimerspec spec = {};
+        spec.it_value.tv_sec = initial.count() / 1000000000;
+        spec.it_value.tv_nsec = initial.count() % 1000000000;
+        spec.it_interval.tv_sec = period.count() / 1000000000;
+        spec.it_interval.tv_nsec = period.count() % 1000000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+          // A zero initial value would disarm the timer
+          spec.it_value.tv_nsec = 1;
+        }
+        timerfd_settime(m_fd, 0, &spec, nullptr);
+      }
+
+      void setPeriod(std::chrono::nanoseconds period) {
+        set(period, period);
+      }
+
+      // Fires once at an absolute CLOCK_MONOTONIC time, right away if it has passed
+      void setAt(timing::Monotonic::time_point deadline) {
+        uint64_t ns = timing::toNanos(deadline);
+        itimerspec spec = {};
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
+        timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+      }
+
+      // Stops the timer until the next set()
+      void disarm() {
+        itimerspec spec = {};
+        timerfd_settime(m_fd, 0, &spec, nullptr);
+        consume();
+      }
+
+      // Returns the number of expirations since the last call (0 if none)
+      uint64_t consume() {
+        uint64_t expirations = 0;
+        if (::read(m_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+          return 0;
+        }
+        return expirations;
+      }
+
+      ~Timer() {
+        if (m_fd >= 0) {
+          close(m_fd);
+          m_fd = -1;
+        }
+      }
+  };
+
+  // eventfd used to wake the loop from another thread (or from a GPIO callback)
+  class Notifier {
+    private:
+      int m_fd = -1;
+
+    public:
+
+      Notifier() {
+        m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_fd < 0) {
+          throw std::runtime_error("Could not create eventfd");
+        }
+      }
+
+      Notifier(const Notifier&) = delete;
+      Notifier& operator=(const Notifier&) = delete;
+
+      int fd() const {
+        return m_fd;
+      }
+
+      // Async-signal-safe and thread-safe
+      void notify() {
+        uint64_t one = 1;
+        ssize_t n = ::write(m_fd, &one, sizeof(one));
+        (void)n;
+      }
+
+      // Returns the number of notifications since the last call (0 if none)
+      uint64_t consume() {
+        uint64_t count = 0;
+        if (::read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+          return 0;
+        }
+        return count;
+      }
+
+      ~Notifier() {
+        if (m_fd >= 0) {
+          close(m_fd);
+          m_fd = -1;
+        }
+      }
+  };
+
+  // Delivers the given signals through a file descriptor instead of async handlers
+  class Signals {
+    private:
+      int m_fd = -1;
+
+    public:
+
+      Signals(std::initializer_list<int> signals) {
+        sigset_t mask;
+        sigemptyset(&mask);
+        for (int signal : signals) {
+          sigaddset(&mask, signal);
+        }
+        // Blocked in this thread; threads started afterwards inherit the mask
+        pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+        m_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (m_fd < 0) {
+          throw std::runtime_error("Could not create signalfd");
+        }
+      }
+
+      Signals(const Signals&) = delete;
+      Signals& operator=(const Signals&) = delete;
+
+      int fd() const {
+        return m_fd;
+      }
+
+      // Returns the next pending signal number, or 0 if none
+      int consume() {
+        signalfd_siginfo info;
+        if (::read(m_fd, &info, sizeof(info)) != sizeof(info)) {
+          return 0;
+        }
+        return static_cast<int>(info.ssi_signo);
+      }
+
+      ~Signals() {
+        if (m_fd >= 0) {
+          close(m_fd);
+          m_fd = -1;
+        }
+      }
+  };
+}
+
+#endif // __REACTOR_H__
@@ -0,0 +1,86 @@
+#ifndef __REALTIME_H__
+#define __REALTIME_H__
+
+#include <cerrno>
+#include <cstddef>
+
+// system headers
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+namespace rt {
+
+  // Real-time settings for the threads on the sampling path
+  struct Profile {
+    int priority = 0;   // SCHED_FIFO priority, 1 (lowest) to 99; 0 keeps the normal scheduler
+    int cpu = -1;       // core to pin to, ideally one kept free of other tasks with isolcpus=; -1 for any
+
+    bool enabled() const {
+      return priority > 0 || cpu >= 0;
+    }
+  };
+
+  // Stack the sampling threads touch up front, well past their deepest call
+  constexpr size_t PREFAULT_STACK = 256 * 1024;
+
+  // Stack of every thread started after lockMemory(), room for PREFAULT_STACK and the frames above it
+  // With MCL_FUTURE each new stack is locked and faulted in whole, so the 8 MB default would pin 8 MB per
+  // thread: a worker per probe (up to 32) and per bus master would lock hundreds of MB on a Pi
+  constexpr size_t THREAD_STACK = 512 * 1024;
+
+  // Locks every page of the process, current and future, so a page fault never stalls a sample
+  // Call it before starting any thread: it also bounds the stacks of the threads created afterwards (std::thread
+  // included) to THREAD_STACK. Returns 0 or -errno (EPERM/ENOMEM without CAP_IPC_LOCK or a large enough
+  // RLIMIT_MEMLOCK)
+  inline int lockMemory() {
+    pthread_attr_t attr;
+    int err = pthread_attr_init(&attr);
+    if (err == 0) {
+      err = pthread_attr_setstacksize(&attr, THREAD_STACK);
+      if (err == 0) {
+        err = pthread_setattr_default_np(&attr);
+      }
+      pthread_attr_destroy(&attr);
+    }
+    if (err != 0) {
+      return -err;
+    }
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? 0 : -errno;
+  }
+
+  // Touches the next PREFAULT_STACK bytes of the calling thread's stack so they are mapped (and locked)
+  [[gnu::noinline]] inline void prefaultStack() {
+    volatile char stack[PREFAULT_STACK];
+    for (size_t i = 0; i < PREFAULT_STACK; i += 4096) {
+      stack[i] = 0;
+    }
+    (void)stack;
+  }
+
+  // Applies a profile to the calling thread: prefaulted stack, pinned to profile.cpu, SCHED_FIFO at profile.priority
+  // Returns 0 or the first -errno (EPERM without CAP_SYS_NICE or a high enough RLIMIT_RTPRIO, EINVAL for a bad cpu)
+  inline int enter(const Profile& profile) {
+    prefaultStack();
+    if (profile.cpu >= 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(profile.cpu, &cpus);
+      int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      if (err != 0) {
+        return -err;
+      }
+    }
+    if (profile.priority > 0) {
+      sched_param param = {};
+      param.sched_priority = profile.priority;
+      int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+      if (err != 0) {
+        return -err;
+      }
+    }
+    return 0;
+  }
+}
+
+#endif // __REALTIME_H__
@@ -1,10 +1,20 @@
 #ifndef __RPI1306I2C_H__
 #define __RPI1306I2C_H__
 
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cerrno>
 #include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <span>
 #include <cmath>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <stdexcept>
 #include <iostream>
 
@@ -12,6 +22,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include "font5x7.hpp"
 
@@ -24,11 +35,18 @@
 #define MEMORYMODE          0x20
 #define COLUMNADDR          0x21
 #define PAGEADDR            0x22
+#define RIGHT_HORIZONTAL_SCROLL              0x26
+#define LEFT_HORIZONTAL_SCROLL               0x27
+#define VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL 0x29
+#define VERTICAL_AND_LEFT_HORIZONTAL_SCROLL  0x2A
+#define DEACTIVATE_SCROLL                    0x2E
+#define ACTIVATE_SCROLL                      0x2F
 #define SETSTARTLINE        0x40
 #define DEFAULT_ADDRESS     0x78
 #define SETCONTRAST         0x81
 #define CHARGEPUMP          0x8D
 #define SEGREMAP            0xA0
+#define SET_VERTICAL_SCROLL_AREA 0xA3
 #define DISPLAYALLON_RESUME 0xA4
 #define DISPLAYALLON        0xA5
 #define NORMALDISPLAY       0xA6
@@ -106,49 +124,107 @@ constexpr uint8_t ssd1306_128x64_init_seq[] = {
 
 namespace i2c {
 
+  // One write to the slave: START, address, data bytes; the messages of a transfer are joined by repeated STARTs
+  struct Message {
+    const uint8_t* data;
+    uint16_t size;
+  };
+
+  // Most messages the kernel takes in one I2C_RDWR ioctl (I2C_RDWR_IOCTL_MAX_MSGS)
+  constexpr size_t MAX_MESSAGES = 42;
+
+  // When a Device opens its adapter
+  //   Now: in the constructor, which throws if the adapter or the address cannot be opened
+  //   Retry: in the constructor too, but a failure leaves the device closed instead of throwing, and every
+  //   transfer() on a closed device tries again (failing with that -errno), so an adapter or a panel that shows
+  //   up after startup is picked up
+  enum class Open { Now, Retry };
+
+  // The Linux i2c-dev bus, talking to one slave address
+  // Display classes are templated on their bus; any class with the same transfer() fits, e.g. a mock that counts
   class Device {
     private:
-      uint8_t m_buffer[128];
-      uint8_t m_dataSize = 0;
       int m_dev = -1;
+      uint8_t m_bus = 0;
+      uint16_t m_addr = 0;
+      bool m_combined = false;
 
-    public:
-
-      Device(uint8_t dev, uint8_t addr) {
-        std::string devPath = "/dev/i2c-";
-        devPath += std::to_string(dev);
+      std::string path() const {
+        return std::string("/dev/i2c-") + std::to_string(m_bus);
+      }
 
-        m_dev = open(devPath.c_str(), O_RDWR);
-        if (m_dev < 0) {
-          throw std::runtime_error(std::string("Could not open ") + devPath);
+      // Opens the adapter and selects the slave; returns 0 or -errno
+      int openAdapter() {
+        int fd = ::open(path().c_str(), O_RDWR);
+        if (fd < 0) {
+          return -errno;
         }
-        if (ioctl(m_dev, I2C_SLAVE, addr) < 0) {
-          throw std::runtime_error(std::string("Could not open ") + std::to_string(addr));
+        if (ioctl(fd, I2C_SLAVE, m_addr) < 0) {
+          int err = -errno;
+          ::close(fd);
+          return err;
         }
+        // Plain I2C adapters take a whole transfer in one I2C_RDWR; SMBus-only ones get a write() per message
+        unsigned long funcs = 0;
+        m_combined = ioctl(fd, I2C_FUNCS, &funcs) == 0 && (funcs & I2C_FUNC_I2C);
+        m_dev = fd;
+        return 0;
       }
 
-      void bufferReset() {
-        m_dataSize = 0;
-      }
+    public:
 
-      void bufferWrite(uint8_t data) {
-        m_buffer[m_dataSize] = data;
-        m_dataSize++;
-        if (m_dataSize == sizeof(m_buffer)) {
-          bufferFlush();
-          bufferWrite(0x40);
+      Device(uint8_t dev, uint8_t addr, Open open = Open::Now): m_bus(dev), m_addr(addr) {
+        int err = openAdapter();
+        if (err < 0 && open == Open::Now) {
+          throw std::runtime_error(std::string("Could not open ") + path() + ": " + std::strerror(-err));
         }
       }
 
-      void bufferFlush() {
-        directWrite(m_buffer, m_dataSize);
-        bufferReset();
+      Device(const Device&) = delete;
+      Device& operator=(const Device&) = delete;
+
+      bool isOpen() const {
+        return m_dev >= 0;
       }
 
-      void directWrite(const uint8_t* data, uint8_t size) {
-        if (write(m_dev, data, size) != size) {
-          throw std::runtime_error("Could not write on device");
+      // Sends the messages in order, as one ioctl per MAX_MESSAGES; returns 0 or -errno
+      // A closed device (Open::Retry) tries to open its adapter first
+      int transfer(std::span<const Message> messages) {
+        if (m_dev < 0) {
+          int err = openAdapter();
+          if (err < 0) {
+            return err;
+          }
         }
+        if (!m_combined) {
+          for (const Message& message : messages) {
+            ssize_t written = ::write(m_dev, message.data, message.size);
+            if (written != message.size) {
+              return written < 0 ? -errno : -EIO;
+            }
+          }
+          return 0;
+        }
+        i2c_msg msgs[MAX_MESSAGES];
+        for (size_t first = 0; first < messages.size(); first += MAX_MESSAGES) {
+          size_t count = std::min(messages.size() - first, MAX_MESSAGES);
+          for (size_t i = 0; i < count; i++) {
+            msgs[i].addr = m_addr;
+            msgs[i].flags = 0;
+            msgs[i].len = messages[first + i].size;
+            msgs[i].buf = const_cast<uint8_t*>(messages[first + i].data);
+          }
+          i2c_rdwr_ioctl_data data = { msgs, static_cast<uint32_t>(count) };
+          if (ioctl(m_dev, I2C_RDWR, &data) < 0) {
+            return -errno;
+          }
+        }
+        return 0;
+      }
+
+      int write(const uint8_t* data, uint16_t size) {
+        Message message = { data, size };
+        return transfer({&message, 1});
       }
 
       ~Device() {
@@ -164,112 +240,853 @@ namespace ssd1306 {
 
   using Bitmap = std::span<const uint8_t>;
 
-  class Display: i2c::Device {
+  // A command stream: one 0x00 control byte (Co=0, D/C#=0) and then nothing but command bytes,
+  // which the controller takes as a single I2C write however long it is
+  template <size_t N>
+  struct Commands {
+    uint8_t bytes[N + 1] = {};
+
+    constexpr size_t size() const {
+      return N + 1;
+    }
+  };
+
+  // Joins command sequences into one stream, at compile time when the sequences are constant,
+  // e.g. constexpr auto stream = commands(ssd1306_128x32_init_seq, {SETCONTRAST, 0xFF});
+  template <size_t... N>
+  constexpr Commands<(N + ...)> commands(const uint8_t (&... sequences)[N]) {
+    Commands<(N + ...)> stream;
+    size_t size = 1;
+    ((std::copy(sequences, sequences + N, stream.bytes + size), size += N), ...);
+    return stream;
+  }
+
+  // The 5 columns of a character's glyph; characters the font does not cover show as '?'
+  constexpr const uint8_t* glyph(char c) {
+    constexpr char LAST = 32 + sizeof(font5x7) / sizeof(font5x7[0]) - 1;
+    if (c < 32 || c > LAST) {
+      c = '?';
+    }
+    return font5x7[c - 32];
+  }
+
+  // A string rasterized at compile time into the framebuffer layout of one page, 6 columns per character
+  // (5 of glyph, 1 of spacing), so showing static text is a copy instead of a walk through the font
+  template <size_t N>
+  struct Label {
+    char text[N + 1] = {};
+    uint8_t columns[N * 6] = {};
+
+    static constexpr size_t length() {
+      return N;
+    }
+  };
+
+  // e.g. static constexpr auto OFF = label("OFF");
+  template <size_t N>
+  constexpr Label<N - 1> label(const char (&text)[N]) {
+    Label<N - 1> rasterized;
+    for (size_t i = 0; i + 1 < N; i++) {
+      rasterized.text[i] = text[i];
+      std::copy(glyph(text[i]), glyph(text[i]) + 5, rasterized.columns + i * 6);
+    }
+    return rasterized;
+  }
+
+  enum class Scroll { Right, Left };
+
+  // What a Display does with a transfer the bus still refuses after its retries
+  //   Throw: a runtime_error out of the call (the default)
+  //   Recover: the transfer is dropped and counted, and the next flush() replays the init sequence and resends
+  //   the whole screen, so a glitch on the bus costs a frame instead of the process
+  enum class OnError { Throw, Recover };
+
+  // Bus failures of a Display since it was constructed
+  struct BusErrors {
+    uint64_t failed = 0;    // transfers that failed at least once
+    uint64_t retries = 0;   // repeated attempts
+    uint64_t dropped = 0;   // transfers given up on in Recover mode
+    uint64_t reinits = 0;   // init sequence replays
+    int lastError = 0;      // -errno of the last failed attempt
+  };
+
+  // Steps of the controller's continuous scroll, one column every so many frames
+  enum class ScrollInterval : uint8_t {
+    Frames2 = 0x07, Frames3 = 0x04, Frames4 = 0x05, Frames5 = 0x00,
+    Frames25 = 0x06, Frames64 = 0x01, Frames128 = 0x02, Frames256 = 0x03,
+  };
+
+  // A Width x Height panel on Bus (i2c::Device on the Pi; the constructor arguments are passed through to it)
+  // Drawing goes into a framebuffer laid out like the controller's GDDRAM (one byte per column per
+  // 8-pixel page, bit 0 on top); flush() then sends only the columns whose bytes actually changed
+  // The geometry is fixed at compile time: page count, buffer sizes and init sequence all follow from Width
+  // and Height, so another panel size is another instantiation. Narrower panels sit centered in the GDDRAM
+  template <uint8_t Width, uint8_t Height, typename Bus = i2c::Device>
+  class Display {
+    static_assert(Width > 0 && Width <= 128, "The SSD1306 drives up to 128 columns");
+    static_assert(Height > 0 && Height <= 64 && Height % 8 == 0, "The SSD1306 drives up to 64 rows, in whole pages");
+
     private:
-      uint8_t m_width = 128;
+      // Pages on screen, and in the controller's RAM, which setStartLine() can roll through
+      static constexpr uint8_t PAGES = Height / 8;
+      static constexpr uint8_t RAM_PAGES = 8;
+      static constexpr uint8_t COLUMN_OFFSET = (128 - Width) / 2;
+      static constexpr std::array<uint8_t, Width> BLANK = {};
+
+      // Room for a full frame in one window, or several smaller windows, per transfer
+      static constexpr size_t TX_SIZE = 2 * RAM_PAGES * Width + 16;
+
+      // A new window costs a command transaction plus a data header, so dirty runs closer than this are
+      // sent as one span, clean columns included
+      static constexpr uint8_t MERGE_GAP = 8;
+
+      uint8_t m_startLine = 0;
+      bool m_scrolling = false;
+      std::array<std::array<uint8_t, Width>, RAM_PAGES> m_frame = {};
+
+      // Settings that a reinit() puts back after the init sequence; -1: the init sequence's own contrast
+      int m_contrast = -1;
+      bool m_on = true;
+
+      // Error handling: every transfer gets up to m_attempts tries, the pause doubling from m_backoff
+      OnError m_onError = OnError::Throw;
+      uint8_t m_attempts = 3;
+      std::chrono::microseconds m_backoff{1000};
+      bool m_lost = false;
+
+      // Written by the thread that draws, readable from any other
+      std::atomic<uint64_t> m_failed{0};
+      std::atomic<uint64_t> m_retries{0};
+      std::atomic<uint64_t> m_dropped{0};
+      std::atomic<uint64_t> m_reinits{0};
+      std::atomic<int> m_lastError{0};
+
+      // Columns changed since the last flush(), one bit per column of each page
+      std::array<std::array<uint64_t, (Width + 63) / 64>, RAM_PAGES> m_dirty = {};
+
+      Bus m_bus;
+
+      // Window commands and data of the spans queued for the next transfer
+      uint8_t m_tx[TX_SIZE];
+      size_t m_txSize = 0;
+      i2c::Message m_messages[i2c::MAX_MESSAGES];
+      size_t m_messageCount = 0;
 
-    protected:
-      using i2c::Device::bufferWrite;
+      bool isDirty(uint8_t page, uint8_t x) const {
+        return (m_dirty[page][x >> 6] >> (x & 63)) & 1;
+      }
+
+      // First dirty span of a page at or after column from, as [x0, x1]; false if there is none
+      bool nextSpan(uint8_t page, uint8_t from, uint8_t& x0, uint8_t& x1) const {
+        uint8_t x = from;
+        while (x < Width && !isDirty(page, x)) {
+          x++;
+        }
+        if (x >= Width) {
+          return false;
+        }
+        x0 = x1 = x;
+        for (uint8_t gap = 0; x < Width && gap <= MERGE_GAP; x++) {
+          if (isDirty(page, x)) {
+            x1 = x;
+            gap = 0;
+          } else {
+            gap++;
+          }
+        }
+        return true;
+      }
+
+      // Whether two pages would be sent as the same column spans
+      bool sameSpans(uint8_t p, uint8_t q) const {
+        uint8_t a0 = 0, a1 = 0, b0 = 0, b1 = 0;
+        for (uint8_t from = 0; from < Width; from = a1 + 1) {
+          bool more = nextSpan(p, from, a0, a1);
+          if (more != nextSpan(q, from, b0, b1)) {
+            return false;
+          }
+          if (!more) {
+            return true;
+          }
+          if (a0 != b0 || a1 != b1) {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      uint8_t* queueMessage(size_t size) {
+        uint8_t* data = m_tx + m_txSize;
+        m_messages[m_messageCount++] = { data, static_cast<uint16_t>(size) };
+        m_txSize += size;
+        return data;
+      }
 
-      uint8_t m_height = 0;
+      // Queues columns x0..x1 of pages p0..p1 as two messages: the window commands, then all of the data
+      // behind a single 0x40 control byte, so even a full frame is one write on the bus
+      void queueSpan(uint8_t p0, uint8_t p1, uint8_t x0, uint8_t x1) {
+        size_t columns = x1 - x0 + 1;
+        size_t size = 1 + (p1 - p0 + 1) * columns;
+        if (m_txSize + 7 + size > TX_SIZE || m_messageCount + 2 > i2c::MAX_MESSAGES) {
+          submit();
+        }
+        uint8_t* window = queueMessage(7);
+        window[0] = 0x00;
+        window[1] = COLUMNADDR;
+        window[2] = COLUMN_OFFSET + x0;
+        window[3] = COLUMN_OFFSET + x1;
+        window[4] = PAGEADDR;
+        window[5] = p0;
+        window[6] = p1;
+        uint8_t* data = queueMessage(size);
+        *data++ = 0x40;
+        for (uint8_t page = p0; page <= p1; page++) {
+          std::copy(&m_frame[page][x0], &m_frame[page][x1] + 1, data);
+          data += columns;
+        }
+      }
 
-      Display(uint8_t dev, uint8_t addr): i2c::Device(dev, addr) {};
+      void count(std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      }
 
-      void initDisplay(const uint8_t* sequence, uint8_t size) {
-        bufferReset();
-        uint8_t command[2] = { 0x00, 0x00 };
-        for (uint8_t i = 0; i < size; i++) {
-          command[1] = sequence[i];
-          directWrite(&command[0], sizeof(command));
+      // One transfer with the retries and backoff of the error handling; returns 0 or the last -errno
+      // Every stream the display sends addresses the controller absolutely (windows, not a moving pointer), so
+      // sending one again, even after part of it got through, leaves the panel as if it had gone through once
+      int send(std::span<const i2c::Message> messages) {
+        int err = m_bus.transfer(messages);
+        if (err >= 0) {
+          return 0;
+        }
+        count(m_failed);
+        std::chrono::microseconds pause = m_backoff;
+        for (uint8_t attempt = 1; attempt < m_attempts && err < 0; attempt++, pause *= 2) {
+          m_lastError.store(err, std::memory_order_relaxed);
+          std::this_thread::sleep_for(pause);
+          count(m_retries);
+          err = m_bus.transfer(messages);
+        }
+        if (err >= 0) {
+          return 0;
+        }
+        m_lastError.store(err, std::memory_order_relaxed);
+        if (m_onError == OnError::Throw) {
+          throw std::runtime_error("Could not write on device");
         }
+        // Whatever the controller holds now is unknown
+        count(m_dropped);
+        m_lost = true;
+        return err;
       }
 
-      void setBlock(uint8_t x, uint8_t y, uint8_t w) {
-        bufferReset();
-        bufferWrite(0x00);
-        bufferWrite(COLUMNADDR);
-        bufferWrite(x);
-        bufferWrite(w ? (x + w - 1) : (m_width - 1));
-        bufferWrite(PAGEADDR);
-        bufferWrite(y);
-        bufferWrite((m_height >> 3) - 1);
-        bufferFlush();
-        bufferWrite(0x40);      
+      // Sends everything queued as one transfer
+      void submit() {
+        if (m_messageCount == 0) {
+          return;
+        }
+        size_t messages = m_messageCount;
+        m_messageCount = 0;
+        m_txSize = 0;
+        send({m_messages, messages});
       }
 
-      void bufferWrite(const Bitmap& bitmap) {
-        for (const auto& u: bitmap) {
-          bufferWrite(u);
+      // The tables the 128x32 and 128x64 modules were brought up with, otherwise a sequence from the geometry:
+      // one COM line per row, and sequential COM pins only where the panel uses every other row of the matrix
+      static constexpr auto initSequence() {
+        if constexpr (Width == 128 && Height == 32) {
+          return commands(ssd1306_128x32_init_seq);
+        } else if constexpr (Width == 128 && Height == 64) {
+          return commands(ssd1306_128x64_init_seq);
+        } else {
+          constexpr uint8_t COM_PINS = (Height == 16 || (Width == 128 && Height == 32)) ? 0x02 : 0x12;
+          return commands({
+            DISPLAYOFF, SETDISPLAYCLOCKDIV, 0x80, SETMULTIPLEX, Height - 1, SETDISPLAYOFFSET, 0x00,
+            SETSTARTLINE | 0x00, CHARGEPUMP, 0x14, SEGREMAP | 0x01, COMSCANDEC, SETCOMPINS, COM_PINS,
+            SETCONTRAST, 0x7F, SETPRECHARGE, 0x22, SETVCOMDETECT, 0x40, MEMORYMODE, HZ_ADDR_MODE,
+            DISPLAYALLON_RESUME, NORMALDISPLAY, DISPLAYON,
+          });
         }
       }
 
+      void init() {
+        static constexpr auto INIT = initSequence();
+        sendCommands(INIT);
+        // Whatever the GDDRAM held before is unknown, the first flush() sends everything
+        invalidate();
+      }
+
+      template <size_t N>
+      int sendCommands(const Commands<N>& stream) {
+        i2c::Message message = { stream.bytes, static_cast<uint16_t>(stream.size()) };
+        return send({&message, 1});
+      }
+
     public:
 
+      // Sends the init sequence as one command stream
+      template <typename... Args>
+      Display(Args&&... args): m_bus(std::forward<Args>(args)...) {
+        init();
+      }
+
+      // The same with an error policy that already covers the init sequence: in Recover mode a panel that does
+      // not answer yet leaves the display lost() instead of throwing, and the first flush() tries again
+      template <typename... Args>
+      Display(OnError onError, Args&&... args): m_onError(onError), m_bus(std::forward<Args>(args)...) {
+        init();
+      }
+
+      Display(const Display&) = delete;
+      Display& operator=(const Display&) = delete;
+
+      Bus& bus() {
+        return m_bus;
+      }
+
+      // attempts: tries per transfer (at least 1), with backoff before the first retry, doubling after each
+      void setErrorHandling(OnError onError, uint8_t attempts = 3,
+                            std::chrono::microseconds backoff = std::chrono::milliseconds(1)) {
+        m_onError = onError;
+        m_attempts = std::max<uint8_t>(attempts, 1);
+        m_backoff = backoff;
+      }
+
+      BusErrors errors() const {
+        return { m_failed.load(std::memory_order_relaxed), m_retries.load(std::memory_order_relaxed),
+                 m_dropped.load(std::memory_order_relaxed), m_reinits.load(std::memory_order_relaxed),
+                 m_lastError.load(std::memory_order_relaxed) };
+      }
+
+      // Whether a transfer was dropped since the last successful reinit(), which the next flush() then does
+      bool lost() const {
+        return m_lost;
+      }
+
+      // Brings the controller back to the state the display expects: the init sequence, then contrast, start
+      // line and power as they were set, and the whole screen marked for the next flush(). A controller that
+      // reset or browned out comes back with its defaults and a random GDDRAM, so nothing it held is trusted;
+      // a running scroll is not restarted. Returns 0 or -errno
+      int reinit() {
+        static constexpr auto INIT = initSequence();
+        count(m_reinits);
+        m_lost = false;
+        int err = sendCommands(INIT);
+        if (err == 0 && m_contrast >= 0) {
+          err = sendCommands(commands({SETCONTRAST, static_cast<uint8_t>(m_contrast)}));
+        }
+        if (err == 0) {
+          err = sendCommands(commands({static_cast<uint8_t>(SETSTARTLINE | m_startLine)}));
+        }
+        if (err == 0 && !m_on) {
+          err = sendCommands(commands({DISPLAYOFF, CHARGEPUMP, 0x10}));
+        }
+        m_scrolling = false;
+        invalidate();
+        return err;
+      }
+
+      void setContrast(uint8_t contrast) {
+        m_contrast = contrast;
+        sendCommands(commands({SETCONTRAST, contrast}));
+      }
+
+      // Sleep mode keeps the GDDRAM, so switching back on needs no flush()
+      void setPower(bool on) {
+        static constexpr auto ON = commands({CHARGEPUMP, 0x14, DISPLAYON});
+        static constexpr auto OFF = commands({DISPLAYOFF, CHARGEPUMP, 0x10});
+        m_on = on;
+        sendCommands(on ? ON : OFF);
+      }
+
+      // GDDRAM row shown on the top line: rolls the picture up by any number of pixel rows, wrapping around
+      // the 64 rows of RAM, without sending a single data byte
+      void setStartLine(uint8_t line) {
+        m_startLine = line & 63;
+        sendCommands(commands({static_cast<uint8_t>(SETSTARTLINE | m_startLine)}));
+      }
+
+      uint8_t startLine() const {
+        return m_startLine;
+      }
+
+      // Starts the controller's continuous horizontal scroll of pages first..last, one column per interval
+      // and, with verticalOffset, also rolling up that many rows each step (within setScrollArea())
+      // The controller moves the GDDRAM itself, so the framebuffer is stale until stopScroll(); columns
+      // scrolled out on one side come back on the other
+      void startScroll(Scroll direction, uint8_t first, uint8_t last, ScrollInterval interval, uint8_t verticalOffset = 0) {
+        uint8_t step = static_cast<uint8_t>(interval);
+        if (verticalOffset == 0) {
+          uint8_t command = direction == Scroll::Right ? RIGHT_HORIZONTAL_SCROLL : LEFT_HORIZONTAL_SCROLL;
+          sendCommands(commands({DEACTIVATE_SCROLL, command, 0x00, first, step, last, 0x00, 0xFF, ACTIVATE_SCROLL}));
+        } else {
+          uint8_t command = direction == Scroll::Right ? VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL
+                                                       : VERTICAL_AND_LEFT_HORIZONTAL_SCROLL;
+          sendCommands(commands({DEACTIVATE_SCROLL, command, 0x00, first, step, last,
+                                 static_cast<uint8_t>(verticalOffset & 63), ACTIVATE_SCROLL}));
+        }
+        m_scrolling = true;
+      }
+
+      // Rows that the vertical part of a scroll moves: rows from top on; the ones above stay fixed
+      void setScrollArea(uint8_t top, uint8_t rows) {
+        sendCommands(commands({SET_VERTICAL_SCROLL_AREA, static_cast<uint8_t>(top & 63), static_cast<uint8_t>(rows & 127)}));
+      }
+
+      // The datasheet requires the RAM to be rewritten after a scroll, so the next flush() resends the screen
+      void stopScroll() {
+        sendCommands(commands({DEACTIVATE_SCROLL}));
+        if (m_scrolling) {
+          m_scrolling = false;
+          invalidate();
+        }
+      }
+
+      bool scrolling() const {
+        return m_scrolling;
+      }
+
+      static constexpr uint8_t width() {
+        return Width;
+      }
+
+      static constexpr uint8_t height() {
+        return Height;
+      }
+
+      // Sets one framebuffer byte (8 vertical pixels), marking the column dirty only if it changed
+      // The framebuffer is the controller's whole GDDRAM: on a panel shorter than 64 pixels the pages past its
+      // height are off screen until setStartLine() rolls them in
+      void setByte(uint8_t page, uint8_t x, uint8_t value) {
+        if (page >= RAM_PAGES || x >= Width || m_frame[page][x] == value) {
+          return;
+        }
+        m_frame[page][x] = value;
+        m_dirty[page][x >> 6] |= uint64_t(1) << (x & 63);
+      }
+
+      // Copies a run of bytes into one page from column x, cut at the right edge; the columns from the first
+      // to the last one that changed are marked dirty. bytes may point into the framebuffer itself
+      void setBytes(uint8_t page, uint8_t x, const uint8_t* bytes, size_t size) {
+        if (page >= RAM_PAGES || x >= Width) {
+          return;
+        }
+        size = std::min<size_t>(size, Width - x);
+        uint8_t* row = &m_frame[page][x];
+        size_t first = std::mismatch(row, row + size, bytes).first - row;
+        if (first == size) {
+          return;
+        }
+        size_t last = size - 1;
+        while (row[last] == bytes[last]) {
+          last--;
+        }
+        std::memmove(row + first, bytes + first, last - first + 1);
+        for (size_t col = x + first; col <= x + last; col = (col | 63) + 1) {
+          // Bits col..min(x + last, end of its word) of one dirty word
+          size_t top = std::min<size_t>(x + last, col | 63);
+          uint64_t bits = ~uint64_t(0) >> (63 - (top & 63));
+          m_dirty[page][col >> 6] |= bits & (~uint64_t(0) << (col & 63));
+        }
+      }
+
+      uint8_t byteAt(uint8_t page, uint8_t x) const {
+        return m_frame[page][x];
+      }
+
+      // Marks every page on screen for the next flush(), e.g. after the panel lost its contents
+      void invalidate() {
+        uint8_t pages = PAGES + ((m_startLine & 7) ? 1 : 0);
+        for (uint8_t i = 0; i < pages; i++) {
+          uint8_t page = ((m_startLine >> 3) + i) % RAM_PAGES;
+          for (uint8_t x = 0; x < Width; x += 64) {
+            m_dirty[page][x >> 6] = Width - x >= 64 ? ~uint64_t(0) : (uint64_t(1) << (Width - x)) - 1;
+          }
+        }
+      }
+
+      bool dirty() const {
+        for (const auto& page : m_dirty) {
+          for (uint64_t bits : page) {
+            if (bits != 0) {
+              return true;
+            }
+          }
+        }
+        return false;
+      }
+
+      // Sends every changed column span, one COLUMNADDR/PAGEADDR window each, all in one transfer
+      // Consecutive pages with the same spans share their windows, so a full-screen change is one window
+      // In Recover mode, a display that lost a transfer is reinitialized first; if that fails too, the frame
+      // waits for the next flush()
+      void flush() {
+        if (m_lost && reinit() < 0) {
+          return;
+        }
+        for (uint8_t page = 0; page < RAM_PAGES; ) {
+          uint8_t lastPage = page;
+          while (lastPage + 1 < RAM_PAGES && sameSpans(page, lastPage + 1)) {
+            lastPage++;
+          }
+          uint8_t x0, x1;
+          for (uint8_t from = 0; from < Width && nextSpan(page, from, x0, x1); from = x1 + 1) {
+            queueSpan(page, lastPage, x0, x1);
+          }
+          for (; page <= lastPage; page++) {
+            for (auto& bits : m_dirty[page]) {
+              bits = 0;
+            }
+          }
+        }
+        submit();
+      }
+
+      // Copies a bitmap of w columns, page by page, to the framebuffer at column x, page y / 8
       void draw(uint8_t x, uint8_t y, uint8_t w, uint8_t h, const Bitmap& bitmap) {
-        uint8_t j;
-        setBlock(x, y >> 3, w);
-        bufferWrite(bitmap);
-        bufferFlush();  
+        if (w == 0) {
+          w = Width - x;
+        }
+        uint8_t pages = h ? (h + 7) >> 3 : (Height - y) >> 3;
+        size_t i = 0;
+        for (uint8_t page = 0; page < pages; page++) {
+          for (uint8_t col = 0; col < w && i < bitmap.size(); col++, i++) {
+            setByte((y >> 3) + page, x + col, bitmap[i]);
+          }
+        }
       }
 
       void clear(uint8_t x, uint8_t y, uint8_t w, uint8_t h) {
-        setBlock(x, y >> 3, w);
-        // no need to iterate, write all the fucking way
-        for (uint8_t m = (h >> 3); m > 0; m--) {
-          for (uint8_t n = w; n > 0; n--) {
-            bufferWrite(0x00);
-          }
+        for (uint8_t page = y >> 3; page < ((y + h) >> 3); page++) {
+          setBytes(page, x, BLANK.data(), w);
         }
-        bufferFlush();
       }
 
+      // The pages on screen, with the start line at 0
       void clear() {
-        clear(0, 0, m_width, m_height);
+        for (uint8_t page = 0; page < PAGES; page++) {
+          setBytes(page, 0, BLANK.data(), Width);
+        }
       }
 
-void drawChar(uint8_t x, uint8_t y, char c) {
-            if (c < 32 || c > 127) c = '?';
-            setBlock(x, y >> 3, 6);
-            for (int i = 0; i < 5; i++) {
-                bufferWrite(font5x7[c - 32][i]);
-            }
-            bufferWrite(0x00);
-            bufferFlush();
-        }
-
-        // Optimized drawString function
-        void drawString(uint8_t x, uint8_t y, const std::string& text) {
-            // Set the block once for the entire string
-            uint8_t string_width = text.length() * 6;
-            setBlock(x, y >> 3, string_width);
-
-            for (char c : text) {
-                if (c < 32 || c > 127) c = '?';
-                // Write character bitmap to the buffer
-                for (int i = 0; i < 5; i++) {
-                    bufferWrite(font5x7[c - 32][i]);
-                }
-                bufferWrite(0x00); // 1 pixel space
-            }
-            bufferFlush(); // Flush the entire buffer in one transaction
+      void setPixel(uint8_t x, uint8_t y, bool on = true) {
+        if (x >= Width || y >= Height) {
+          return;
+        }
+        uint8_t bit = 1 << (y & 7);
+        setByte(y >> 3, x, on ? (m_frame[y >> 3][x] | bit) : (m_frame[y >> 3][x] & ~bit));
+      }
+
+      // Bresenham line, both ends included
+      void drawLine(int x0, int y0, int x1, int y1, bool on = true) {
+        int dx = std::abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        int dy = -std::abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        for (int err = dx + dy; ; ) {
+          if (x0 >= 0 && y0 >= 0) {
+            setPixel(x0, y0, on);
+          }
+          if (x0 == x1 && y0 == y1) {
+            break;
+          }
+          int e2 = 2 * err;
+          if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+          }
+          if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+          }
+        }
+      }
+
+      // Sets (or clears) a w x h rectangle at any pixel position, one byte write per column and page
+      void fillRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, bool on = true) {
+        int bottom = std::min<int>(y + h, Height);
+        for (int top = y; top < bottom; top = (top | 7) + 1) {
+          uint8_t page = top >> 3;
+          int end = std::min(bottom, (top | 7) + 1);
+          uint8_t mask = (0xFF << (top & 7)) & (0xFF >> (((page + 1) << 3) - end));
+          for (uint8_t col = x; col < std::min<int>(x + w, Width); col++) {
+            setByte(page, col, on ? (m_frame[page][col] | mask) : (m_frame[page][col] & ~mask));
+          }
+        }
+      }
+
+      // Shifts the pages of w columns from x one column to the left, leaving the rightmost column as it was;
+      // only the columns whose bytes actually change become dirty
+      void shiftLeft(uint8_t x, uint8_t page, uint8_t w, uint8_t pages) {
+        for (uint8_t p = page; p < std::min<int>(page + pages, RAM_PAGES); p++) {
+          setBytes(p, x, &m_frame[p][x + 1], w - 1);
+        }
+      }
+
+      void drawChar(uint8_t x, uint8_t y, char c) {
+        const uint8_t* columns = glyph(c);
+        for (int i = 0; i < 5; i++) {
+          setByte(y >> 3, x + i, columns[i]);
         }
-    };
+        setByte(y >> 3, x + 5, 0x00);
+      }
+
+      template <size_t N>
+      void drawLabel(uint8_t x, uint8_t y, const Label<N>& label) {
+        setBytes(y >> 3, x, label.columns, sizeof(label.columns));
+      }
+
+      // 6 columns per character (5 of glyph, 1 of spacing); only glyphs that differ from what is
+      // already in the framebuffer end up in the next flush()
+      void drawString(uint8_t x, uint8_t y, const std::string& text) {
+        for (char c : text) {
+          if (x + 6 > Width) {
+            break;
+          }
+          drawChar(x, y, c);
+          x += 6;
+        }
+      }
+  };
+
+  // Text rows on top of a display's framebuffer: 8-pixel rows of 6-column cells, remembering the character
+  // in every cell. print() draws only the cells whose character changed and blanks the leftover cells of a
+  // shorter line, so lines need no padding and an unchanged character costs neither drawing nor I2C traffic
+  // Drawing over its rows by other means needs an invalidate()
+  template <typename Panel>
+  class TextLayer {
+    private:
+      static constexpr uint8_t CELL_WIDTH = 6;
+      static constexpr uint8_t ROWS = Panel::height() / 8;
+      static constexpr uint8_t COLUMNS = Panel::width() / CELL_WIDTH;
+
+      // Unknown cell content, redrawn by the next print()
+      static constexpr char UNKNOWN = '\0';
+
+      Panel& m_display;
+      char m_cells[ROWS][COLUMNS];
+      uint8_t m_length[ROWS] = {};
+      uint64_t m_glyphs = 0;
 
-  class Display128x32: public Display {
     public:
-      Display128x32(uint8_t dev, uint8_t addr): Display(dev, addr) {
-        m_height = 32;
-        initDisplay(ssd1306_128x32_init_seq, sizeof(ssd1306_128x32_init_seq));
+
+      // Assumes a blank display
+      TextLayer(Panel& display): m_display(display) {
+        for (auto& row : m_cells) {
+          std::fill(std::begin(row), std::end(row), ' ');
+        }
+      }
+
+      static constexpr uint8_t rows() {
+        return ROWS;
+      }
+
+      static constexpr uint8_t columns() {
+        return COLUMNS;
+      }
+
+      // Shows text on row (0 at the top) from its first cell, cut at the right edge
+      void print(uint8_t row, std::string_view text) {
+        end(row, put(row, 0, text));
+      }
+
+      // Writes text into row from cell column on, through the glyph path; returns the cell after it
+      // A line built from several put() calls is finished with end()
+      uint8_t put(uint8_t row, uint8_t column, std::string_view text) {
+        if (row >= rows()) {
+          return column;
+        }
+        uint8_t last = std::min<size_t>(column + text.size(), columns());
+        for (uint8_t cell = column; cell < last; cell++) {
+          char c = text[cell - column];
+          if (m_cells[row][cell] != c) {
+            m_display.drawChar(cell * CELL_WIDTH, row * 8, c);
+            m_cells[row][cell] = c;
+            m_glyphs++;
+          }
+        }
+        return last;
+      }
+
+      // Same for a label, copied in one go if any of its characters differ from the cells
+      template <size_t N>
+      uint8_t put(uint8_t row, uint8_t column, const Label<N>& label) {
+        if (row >= rows()) {
+          return column;
+        }
+        uint8_t last = std::min<size_t>(column + N, columns());
+        if (!std::equal(label.text, label.text + (last - column), &m_cells[row][column])) {
+          m_display.drawLabel(column * CELL_WIDTH, row * 8, label);
+          std::copy(label.text, label.text + (last - column), &m_cells[row][column]);
+          m_glyphs++;
+        }
+        return last;
+      }
+
+      // Ends a row's line at cell column, blanking what is left of the previous, longer one
+      void end(uint8_t row, uint8_t column) {
+        if (row >= rows()) {
+          return;
+        }
+        for (uint8_t cell = column; cell < m_length[row]; cell++) {
+          if (m_cells[row][cell] != ' ') {
+            m_display.clear(cell * CELL_WIDTH, row * 8, CELL_WIDTH, 8);
+            m_cells[row][cell] = ' ';
+            m_glyphs++;
+          }
+        }
+        m_length[row] = column;
+      }
+
+      // Blanks every row
+      void clear() {
+        for (uint8_t row = 0; row < rows(); row++) {
+          print(row, "");
+        }
+      }
+
+      // Forgets what the cells hold, the next print() of each row redraws it whole and blanks the rest
+      void invalidate() {
+        for (uint8_t row = 0; row < ROWS; row++) {
+          std::fill(std::begin(m_cells[row]), std::end(m_cells[row]), UNKNOWN);
+          m_length[row] = COLUMNS;
+        }
+      }
+
+      // Cells drawn or blanked and labels copied so far
+      uint64_t glyphs() const {
+        return m_glyphs;
       }
   };
 
-  class Display128x64: public Display {
+  // Graph of the last values in an area of whole pages, one column per value and the newest on the right
+  // push() shifts the plot one column to the left in the framebuffer and draws only the new column; update()
+  // redraws the newest column. A value outside the current range widens it, which redraws the whole graph
+  template <typename Panel>
+  class Sparkline {
+    private:
+      Panel& m_display;
+      uint8_t m_x, m_page, m_width, m_pages;
+      float m_minSpan;
+
+      // Ring of the last m_width values, m_head is the oldest once it is full
+      float m_values[Panel::width()] = {};
+      uint8_t m_count = 0;
+      uint8_t m_head = 0;
+      float m_low = 0, m_high = 0;
+      bool m_visible = true;
+
+      float value(uint8_t age) const {
+        return m_values[(m_head + m_count - 1 - age) % m_width];
+      }
+
+      // Pixel row of a value inside the area, the bottom row for the low end of the range
+      int rowOf(float v) const {
+        int height = m_pages * 8;
+        int row = static_cast<int>((v - m_low) / (m_high - m_low) * (height - 1) + 0.5f);
+        return m_page * 8 + height - 1 - std::clamp(row, 0, height - 1);
+      }
+
+      // The column of the value of that age: a vertical run joining it to the previous one, so steps stay connected
+      void drawColumn(uint8_t age) {
+        uint8_t x = m_x + m_width - 1 - age;
+        int row = rowOf(value(age));
+        int previous = age + 1 < m_count ? rowOf(value(age + 1)) : row;
+        int top = std::min(row, previous), bottom = std::max(row, previous);
+        for (uint8_t page = m_page; page < m_page + m_pages; page++) {
+          int from = std::max(top, page * 8), to = std::min(bottom, page * 8 + 7);
+          uint8_t bits = from <= to ? (0xFF << (from & 7)) & (0xFF >> (7 - (to & 7))) : 0;
+          m_display.setByte(page, x, bits);
+        }
+      }
+
+      // Widens the range to take v, with a quarter of the span as headroom; true if it changed
+      bool fit(float v) {
+        if (m_count > 0 && v >= m_low && v <= m_high) {
+          return false;
+        }
+        float low = m_count > 0 ? std::min(m_low, v) : v;
+        float high = m_count > 0 ? std::max(m_high, v) : v;
+        float margin = std::max(high - low, m_minSpan) / 4;
+        m_low = low - margin;
+        m_high = high + margin;
+        return true;
+      }
+
     public:
-      Display128x64(uint8_t dev, uint8_t addr): Display(dev, addr) {
-        m_height = 64;
-        initDisplay(ssd1306_128x64_init_seq, sizeof(ssd1306_128x64_init_seq));
+
+      // width columns from x, height pixels from y (both rounded down to whole pages); minSpan keeps noise
+      // on a steady reading from filling the whole height
+      Sparkline(Panel& display, uint8_t x, uint8_t y, uint8_t width, uint8_t height, float minSpan = 1.0f)
+        : m_display(display), m_x(x), m_page(y >> 3), m_width(std::min(width, Panel::width())),
+          m_pages(std::max(height >> 3, 1)), m_minSpan(minSpan) {}
+
+      uint8_t size() const {
+        return m_count;
+      }
+
+      void push(float v) {
+        bool rescaled = fit(v);
+        if (m_count < m_width) {
+          m_count++;
+        } else {
+          m_head = (m_head + 1) % m_width;
+        }
+        m_values[(m_head + m_count - 1) % m_width] = v;
+        if (!m_visible) {
+          return;
+        }
+        if (rescaled) {
+          redraw();
+        } else {
+          m_display.shiftLeft(m_x, m_page, m_width, m_pages);
+          drawColumn(0);
+        }
+      }
+
+      // Replaces the newest value, e.g. the running mean of a bucket that is still filling
+      void update(float v) {
+        if (m_count == 0) {
+          push(v);
+          return;
+        }
+        bool rescaled = fit(v);
+        m_values[(m_head + m_count - 1) % m_width] = v;
+        if (m_visible) {
+          rescaled ? redraw() : drawColumn(0);
+        }
+      }
+
+      void redraw() {
+        m_display.clear(m_x, m_page * 8, m_width, m_pages * 8);
+        for (uint8_t age = 0; age < m_count; age++) {
+          drawColumn(age);
+        }
+      }
+
+      // A hidden graph keeps taking values but leaves its area blank for something else
+      void hide() {
+        if (m_visible) {
+          m_visible = false;
+          m_display.clear(m_x, m_page * 8, m_width, m_pages * 8);
+        }
+      }
+
+      void show() {
+        if (!m_visible) {
+          m_visible = true;
+          redraw();
+        }
+      }
+
+      void clear() {
+        m_count = 0;
+        m_head = 0;
+        if (m_visible) {
+          m_display.clear(m_x, m_page * 8, m_width, m_pages * 8);
+        }
       }
   };
+
+  using Display128x32 = Display<128, 32>;
+  using Display128x64 = Display<128, 64>;
 }
 
 #endif // __RPI1306I2C_H__
\ No newline at end of file
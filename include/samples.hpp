@@ -0,0 +1,142 @@
+#ifndef __SAMPLES_H__
+#define __SAMPLES_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace samples {
+
+  enum class Status : uint8_t {
+    Ok,           // milliCelsius holds the reading
+    Off,          // sensor disabled by its button or the server
+    Unplugged,    // enabled but no reading (missing probe, timeout)
+    Invalid,      // a reading came back but failed its CRC or did not parse
+  };
+
+  struct Sample {
+    uint64_t monotonicNs = 0;
+    uint64_t publishedNs = 0;   // when the producer had the reading in hand, 0 if it did not say
+    uint16_t sensor = 0;
+    Status status = Status::Off;
+    int32_t milliCelsius = 0;
+  };
+
+  // Per-reader position in a Ring, each consumer owns one
+  struct Reader {
+    uint64_t next = 0;      // index of the next sample to read
+    uint64_t dropped = 0;   // samples overwritten before this reader got to them
+  };
+
+  enum class ReadResult : uint8_t {
+    Ok,         // a sample was copied out
+    Empty,      // the reader is caught up
+    Overrun,    // the producer lapped the reader, the cursor skipped ahead (see Reader::dropped)
+  };
+
+  // Fixed-capacity ring of timestamped samples: one producer, any number of wait-free readers
+  // The producer never waits for readers, it overwrites the oldest slot (drop-oldest). Every slot carries
+  // a sequence number that doubles as a seqlock, so a reader that gets lapped while copying notices and
+  // skips ahead instead of retrying. All storage lives inside the object, nothing is allocated after construction
+  template <size_t Capacity>
+  class Ring {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Ring capacity must be a power of two");
+
+    private:
+      static constexpr size_t CACHE_LINE = 64;
+      static constexpr uint64_t MASK = Capacity - 1;
+
+      // Two slots per cache line; the payload is kept in atomic words so the seqlock copy is race free
+      struct alignas(32) Slot {
+        std::atomic<uint64_t> sequence{0};    // 2 * index + 1 while writing, 2 * index + 2 once published
+        std::atomic<uint64_t> timestamp{0};
+        std::atomic<uint64_t> published{0};
+        std::atomic<uint64_t> payload{0};     // sensor << 48 | status << 32 | milliCelsius
+      };
+
+      alignas(CACHE_LINE) std::atomic<uint64_t> m_head{0};    // samples ever published
+      alignas(CACHE_LINE) Slot m_slots[Capacity];
+
+      static uint64_t pack(const Sample& sample) {
+        return (static_cast<uint64_t>(sample.sensor) << 48) |
+               (static_cast<uint64_t>(sample.status) << 32) |
+               static_cast<uint32_t>(sample.milliCelsius);
+      }
+
+      static void unpack(uint64_t timestamp, uint64_t published, uint64_t payload, Sample& sample) {
+        sample.monotonicNs = timestamp;
+        sample.publishedNs = published;
+        sample.sensor = static_cast<uint16_t>(payload >> 48);
+        sample.status = static_cast<Status>((payload >> 32) & 0xFF);
+        sample.milliCelsius = static_cast<int32_t>(static_cast<uint32_t>(payload));
+      }
+
+    public:
+
+      static constexpr size_t capacity() {
+        return Capacity;
+      }
+
+      // Producer only
+      void push(const Sample& sample) {
+        uint64_t index = m_head.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[index & MASK];
+
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.timestamp.store(sample.monotonicNs, std::memory_order_relaxed);
+        slot.published.store(sample.publishedNs, std::memory_order_relaxed);
+        slot.payload.store(pack(sample), std::memory_order_relaxed);
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+        m_head.store(index + 1, std::memory_order_release);
+      }
+
+      uint64_t published() const {
+        return m_head.load(std::memory_order_acquire);
+      }
+
+      // A reader that starts with the next sample to be pushed
+      Reader reader() const {
+        return Reader{published(), 0};
+      }
+
+      // A reader that starts with the oldest sample still held
+      Reader oldest() const {
+        uint64_t head = published();
+        return Reader{head > Capacity ? head - Capacity : 0, 0};
+      }
+
+      // Copies the reader's next sample out, never blocks and never retries
+      ReadResult read(Reader& reader, Sample& sample) const {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        if (reader.next >= head) {
+          return ReadResult::Empty;
+        }
+        if (head - reader.next > Capacity) {
+          reader.dropped += head - Capacity - reader.next;
+          reader.next = head - Capacity;
+        }
+
+        uint64_t index = reader.next;
+        const Slot& slot = m_slots[index & MASK];
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        uint64_t timestamp = slot.timestamp.load(std::memory_order_relaxed);
+        uint64_t published = slot.published.load(std::memory_order_relaxed);
+        uint64_t payload = slot.payload.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+
+        reader.next = index + 1;
+        if (before != 2 * index + 2 || after != before) {
+          // Overwritten under us, this sample is gone
+          reader.dropped++;
+          return ReadResult::Overrun;
+        }
+        unpack(timestamp, published, payload, sample);
+        return ReadResult::Ok;
+      }
+  };
+}
+
+#endif // __SAMPLES_H__
@@ -0,0 +1,157 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+// system headers
+#include <time.h>
+
+#include "timing.hpp"
+
+namespace scheduler {
+
+  // Fixed-rate schedule: deadline k is start + k * period, whatever each cycle costs, so samples stay evenly
+  // spaced instead of drifting by the work done in every cycle. A cycle that overruns whole periods skips
+  // those deadlines (counted in missed()) rather than firing them back to back
+  template <typename Clock>
+  class BasicDeadlines {
+    private:
+      std::chrono::nanoseconds m_period;
+      typename Clock::time_point m_next;
+      std::atomic<uint64_t> m_missed{0};
+
+    public:
+
+      explicit BasicDeadlines(std::chrono::nanoseconds period) : m_period(period) {}
+
+      // The first deadline, the next ones follow on the grid
+      void start(typename Clock::time_point first) {
+        m_next = first;
+      }
+
+      typename Clock::time_point next() const {
+        return m_next;
+      }
+
+      std::chrono::nanoseconds period() const {
+        return m_period;
+      }
+
+      // Takes effect from the pending deadline, which moves to the last one plus the new period
+      // Call it between cycles, after advance(): during a cycle next() is still the deadline being served,
+      // which would move by the difference and leave the grid off by it from then on
+      void setPeriod(std::chrono::nanoseconds period) {
+        m_next += period - m_period;
+        m_period = period;
+      }
+
+      // Moves past the deadline just served to the first one after now
+      typename Clock::time_point advance(typename Clock::time_point now) {
+        m_next += m_period;
+        if (m_next <= now) {
+          auto behind = (now - m_next) / m_period + 1;
+          m_missed.store(m_missed.load(std::memory_order_relaxed) + behind, std::memory_order_relaxed);
+          m_next += behind * m_period;
+        }
+        return m_next;
+      }
+
+      // Deadlines skipped because a cycle overran them, readable from any thread
+      uint64_t missed() const {
+        return m_missed.load(std::memory_order_relaxed);
+      }
+  };
+
+  using Deadlines = BasicDeadlines<timing::Monotonic>;
+
+  // Blocks until an absolute CLOCK_MONOTONIC deadline, the time spent before the call does not push it back
+  inline void sleepUntil(timing::Monotonic::time_point deadline) {
+    uint64_t ns = timing::toNanos(deadline);
+    timespec until;
+    until.tv_sec = ns / 1000000000;
+    until.tv_nsec = ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) == EINTR) {
+    }
+  }
+
+  // Log-linear histogram of durations: 8 buckets per power of two, so a percentile comes out within 12.5%
+  // of the true value at any scale, in a fixed 4 KB. Written by one thread, readable from any
+  class Histogram {
+    private:
+      static constexpr int SUB_BITS = 3;
+      static constexpr uint64_t SUBS = 1 << SUB_BITS;
+      static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUBS;
+
+      std::atomic<uint64_t> m_counts[BUCKETS] = {};
+      std::atomic<uint64_t> m_total{0};
+      std::atomic<uint64_t> m_maxNs{0};
+
+      static size_t bucket(uint64_t ns) {
+        if (ns < SUBS) {
+          return ns;
+        }
+        int msb = std::bit_width(ns) - 1;
+        uint64_t sub = (ns >> (msb - SUB_BITS)) & (SUBS - 1);
+        return (msb - SUB_BITS + 1) * SUBS + sub;
+      }
+
+      // Largest value that lands in a bucket
+      static uint64_t upperBound(size_t index) {
+        if (index < SUBS) {
+          return index;
+        }
+        int msb = index / SUBS + SUB_BITS - 1;
+        uint64_t sub = index % SUBS;
+        return ((SUBS + sub + 1) << (msb - SUB_BITS)) - 1;
+      }
+
+    public:
+
+      // Writer only, negative durations count as zero
+      void record(std::chrono::nanoseconds value) {
+        uint64_t ns = value.count() > 0 ? value.count() : 0;
+        std::atomic<uint64_t>& count = m_counts[bucket(ns)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_total.store(m_total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (ns > m_maxNs.load(std::memory_order_relaxed)) {
+          m_maxNs.store(ns, std::memory_order_relaxed);
+        }
+      }
+
+      uint64_t count() const {
+        return m_total.load(std::memory_order_relaxed);
+      }
+
+      std::chrono::nanoseconds max() const {
+        return std::chrono::nanoseconds(m_maxNs.load(std::memory_order_relaxed));
+      }
+
+      // Upper bound of the bucket holding the given fraction (0.5 for p50, 0.99 for p99) of the values
+      std::chrono::nanoseconds percentile(double fraction) const {
+        uint64_t total = 0;
+        for (const auto& count : m_counts) {
+          total += count.load(std::memory_order_relaxed);
+        }
+        if (total == 0) {
+          return std::chrono::nanoseconds(0);
+        }
+        uint64_t target = std::max<uint64_t>(1, std::ceil(fraction * total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+          seen += m_counts[i].load(std::memory_order_relaxed);
+          if (seen >= target) {
+            return std::min(std::chrono::nanoseconds(upperBound(i)), max());
+          }
+        }
+        return max();
+      }
+  };
+}
+
+#endif // __SCHEDULER_H__
@@ -0,0 +1,274 @@
+#ifndef __SSD1306EMU_H__
+#define __SSD1306EMU_H__
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "rpi1306i2c.hpp"
+
+namespace ssd1306 {
+
+  // Software SSD1306 behind the bus interface, so a Display runs without /dev/i2c-* or a panel:
+  //   ssd1306::Display<128, 32, ssd1306::Emulator> display;
+  // It decodes the control bytes and commands of every message into a model of the 128x64 GDDRAM (addressing
+  // modes, COLUMNADDR/PAGEADDR windows, page-mode column and page commands, start line, invert, on/off),
+  // counts what crossed the bus, and renders what the panel would show. The panel's width is a constructor
+  // argument (narrower panels show the middle columns of the RAM), its height is taken from SETMULTIPLEX.
+  // The init tables flip segments and COM scan to match how the modules are wired, so the image is rendered
+  // in RAM order; scrolling is recorded but not animated
+  class Emulator {
+    public:
+      static constexpr uint8_t RAM_WIDTH = 128;
+      static constexpr uint8_t RAM_PAGES = 8;
+
+      // Bus traffic since the last resetCounters()
+      struct Counters {
+        uint64_t transfers = 0;
+        uint64_t messages = 0;
+        uint64_t bytes = 0;
+        uint64_t commandBytes = 0;
+        uint64_t dataBytes = 0;
+      };
+
+    private:
+      std::array<std::array<uint8_t, RAM_WIDTH>, RAM_PAGES> m_ram = {};
+      uint8_t m_width;
+      uint8_t m_height = 64;
+      Counters m_counters;
+
+      // Transfers still to refuse, and with what
+      unsigned int m_failing = 0;
+      int m_failError = -EIO;
+
+      // Controller state
+      uint8_t m_mode = PG_ADDR_MODE;
+      uint8_t m_colStart = 0, m_colEnd = RAM_WIDTH - 1;
+      uint8_t m_pageStart = 0, m_pageEnd = RAM_PAGES - 1;
+      uint8_t m_col = 0, m_page = 0;
+      uint8_t m_startLine = 0;
+      uint8_t m_offset = 0;
+      uint8_t m_contrast = 0x7F;
+      bool m_on = false;
+      bool m_inverted = false;
+      bool m_allOn = false;
+      bool m_scrolling = false;
+
+      // A command waiting for its argument bytes
+      std::vector<uint8_t> m_command;
+
+      // Argument bytes that follow a command's first byte
+      static size_t arguments(uint8_t command) {
+        switch (command) {
+          case MEMORYMODE: case SETCONTRAST: case CHARGEPUMP: case SETMULTIPLEX: case SETDISPLAYOFFSET:
+          case SETDISPLAYCLOCKDIV: case SETPRECHARGE: case SETCOMPINS: case SETVCOMDETECT:
+            return 1;
+          case COLUMNADDR: case PAGEADDR: case SET_VERTICAL_SCROLL_AREA:
+            return 2;
+          case VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL: case VERTICAL_AND_LEFT_HORIZONTAL_SCROLL:
+            return 5;
+          case RIGHT_HORIZONTAL_SCROLL: case LEFT_HORIZONTAL_SCROLL:
+            return 6;
+          default:
+            return 0;
+        }
+      }
+
+      void command(uint8_t byte) {
+        m_counters.commandBytes++;
+        m_command.push_back(byte);
+        if (m_command.size() <= arguments(m_command[0])) {
+          return;
+        }
+        const std::vector<uint8_t>& c = m_command;
+        if (c[0] <= 0x0F) {
+          m_col = (m_col & 0xF0) | c[0];
+        } else if (c[0] <= 0x1F) {
+          m_col = ((c[0] & 0x07) << 4) | (m_col & 0x0F);
+        } else if (c[0] == MEMORYMODE) {
+          m_mode = c[1] & 0x03;
+        } else if (c[0] == COLUMNADDR) {
+          m_colStart = m_col = c[1] & 0x7F;
+          m_colEnd = c[2] & 0x7F;
+        } else if (c[0] == PAGEADDR) {
+          m_pageStart = m_page = c[1] & 0x07;
+          m_pageEnd = c[2] & 0x07;
+        } else if (c[0] == DEACTIVATE_SCROLL) {
+          m_scrolling = false;
+        } else if (c[0] == ACTIVATE_SCROLL) {
+          m_scrolling = true;
+        } else if (c[0] >= SETSTARTLINE && c[0] <= SETSTARTLINE + 63) {
+          m_startLine = c[0] & 63;
+        } else if (c[0] == SETCONTRAST) {
+          m_contrast = c[1];
+        } else if (c[0] == DISPLAYALLON_RESUME || c[0] == DISPLAYALLON) {
+          m_allOn = c[0] == DISPLAYALLON;
+        } else if (c[0] == NORMALDISPLAY || c[0] == INVERTDISPLAY) {
+          m_inverted = c[0] == INVERTDISPLAY;
+        } else if (c[0] == SETMULTIPLEX) {
+          m_height = (c[1] & 63) + 1;
+        } else if (c[0] == SETDISPLAYOFFSET) {
+          m_offset = c[1] & 63;
+        } else if (c[0] == DISPLAYOFF || c[0] == DISPLAYON) {
+          m_on = c[0] == DISPLAYON;
+        } else if (c[0] >= SETPAGE && c[0] <= SETPAGE + 7) {
+          m_page = c[0] & 0x07;
+        }
+        m_command.clear();
+      }
+
+      // One GDDRAM byte at the pointer, which then moves on as the addressing mode says
+      void data(uint8_t byte) {
+        m_counters.dataBytes++;
+        m_ram[m_page][m_col] = byte;
+        if (m_mode == HZ_ADDR_MODE) {
+          if (m_col++ >= m_colEnd) {
+            m_col = m_colStart;
+            m_page = m_page >= m_pageEnd ? m_pageStart : m_page + 1;
+          }
+        } else if (m_mode == VT_ADDR_MODE) {
+          if (m_page++ >= m_pageEnd) {
+            m_page = m_pageStart;
+            m_col = m_col >= m_colEnd ? m_colStart : m_col + 1;
+          }
+        } else {
+          m_col = (m_col + 1) & 0x7F;
+        }
+      }
+
+    public:
+
+      explicit Emulator(uint8_t width = RAM_WIDTH): m_width(width) {}
+
+      // The bus interface: one message is one I2C write of control and payload bytes
+      // A control byte with Co set covers only the byte after it; with Co clear, everything left in the
+      // message is commands (D/C# clear) or GDDRAM data (D/C# set)
+      int transfer(std::span<const i2c::Message> messages) {
+        m_counters.transfers++;
+        if (m_failing > 0) {
+          m_failing--;
+          return m_failError;
+        }
+        for (const i2c::Message& message : messages) {
+          m_counters.messages++;
+          m_counters.bytes += message.size;
+          size_t i = 0;
+          while (i < message.size) {
+            uint8_t control = message.data[i++];
+            bool isData = control & 0x40;
+            if (control & 0x80) {
+              if (i < message.size) {
+                isData ? data(message.data[i]) : command(message.data[i]);
+                i++;
+              }
+              continue;
+            }
+            for (; i < message.size; i++) {
+              isData ? data(message.data[i]) : command(message.data[i]);
+            }
+          }
+        }
+        return 0;
+      }
+
+      // Fault injection: the next transfers calls fail with err (a NAK on the real bus) and change nothing
+      void failNext(unsigned int transfers, int err = -EIO) {
+        m_failing = transfers;
+        m_failError = err;
+      }
+
+      // A reset or brownout of the controller: registers back to their power-on values, display off, and
+      // GDDRAM contents that have nothing to do with the last frame
+      void powerCycle() {
+        for (auto& page : m_ram) {
+          page.fill(0x5A);
+        }
+        m_mode = PG_ADDR_MODE;
+        m_colStart = m_col = 0;
+        m_colEnd = RAM_WIDTH - 1;
+        m_pageStart = m_page = 0;
+        m_pageEnd = RAM_PAGES - 1;
+        m_startLine = 0;
+        m_offset = 0;
+        m_height = 64;
+        m_contrast = 0x7F;
+        m_on = m_inverted = m_allOn = m_scrolling = false;
+        m_command.clear();
+      }
+
+      const Counters& counters() const {
+        return m_counters;
+      }
+
+      void resetCounters() {
+        m_counters = {};
+      }
+
+      uint8_t ram(uint8_t page, uint8_t column) const {
+        return m_ram[page][column];
+      }
+
+      uint8_t width() const {
+        return m_width;
+      }
+
+      uint8_t height() const {
+        return m_height;
+      }
+
+      uint8_t startLine() const {
+        return m_startLine;
+      }
+
+      uint8_t contrast() const {
+        return m_contrast;
+      }
+
+      bool on() const {
+        return m_on;
+      }
+
+      bool scrolling() const {
+        return m_scrolling;
+      }
+
+      // Whether the pixel at (x, y) of the visible image is lit: RAM row (startLine + offset + y) mod 64
+      bool pixel(uint8_t x, uint8_t y) const {
+        if (!m_on || x >= m_width || y >= m_height) {
+          return false;
+        }
+        if (m_allOn) {
+          return true;
+        }
+        uint8_t row = (m_startLine + m_offset + y) & 63;
+        bool lit = (m_ram[row >> 3][(RAM_WIDTH - m_width) / 2 + x] >> (row & 7)) & 1;
+        return lit != m_inverted;
+      }
+
+      // Writes the visible image as a binary PBM (P4), lit pixels black; returns 0 or -errno
+      int writePbm(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+          return -(errno ? errno : EIO);
+        }
+        file << "P4\n" << int(m_width) << " " << int(m_height) << "\n";
+        for (uint8_t y = 0; y < m_height; y++) {
+          uint8_t bits = 0;
+          for (uint8_t x = 0; x < m_width; x++) {
+            bits |= pixel(x, y) << (7 - (x & 7));
+            if ((x & 7) == 7 || x + 1 == m_width) {
+              file.put(static_cast<char>(bits));
+              bits = 0;
+            }
+          }
+        }
+        return file ? 0 : -EIO;
+      }
+  };
+}
+
+#endif // __SSD1306EMU_H__
@@ -0,0 +1,98 @@
+#ifndef __TIMING_H__
+#define __TIMING_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+// system headers
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace timing {
+
+  // The clock behind every timestamp, deadline and latency in the thermostat
+  // steady_clock is CLOCK_MONOTONIC on Linux: it never jumps with the wall clock, it is the base of timerfd,
+  // clock_nanosleep and GPIO edge timestamps, and it counts signed 64-bit nanoseconds, which wrap after 292 years
+  // (the 32-bit millis() it replaces wrapped after 49.7 days)
+  using Monotonic = std::chrono::steady_clock;
+  static_assert(Monotonic::is_steady, "The monotonic clock must be steady");
+  static_assert(std::is_same_v<Monotonic::duration, std::chrono::nanoseconds>, "The monotonic clock must count nanoseconds");
+
+  // A time point as unsigned nanoseconds since its clock's epoch, the form samples and kernel events carry
+  template <typename TimePoint>
+  uint64_t toNanos(TimePoint time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+  }
+
+  template <typename Clock = Monotonic>
+  uint64_t nowNanos() {
+    return toNanos(Clock::now());
+  }
+
+  // Time since the kernel started this process, from the starttime field of /proc/self/stat, so it includes
+  // exec, dynamic loading and everything before main(); clock-tick resolution (usually 10 ms), -1 ns if unreadable
+  inline std::chrono::nanoseconds sinceProcessStart() {
+    char stat[1024];
+    int fd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return std::chrono::nanoseconds(-1);
+    }
+    ssize_t size = read(fd, stat, sizeof(stat) - 1);
+    close(fd);
+    if (size <= 0) {
+      return std::chrono::nanoseconds(-1);
+    }
+    stat[size] = '\0';
+
+    // The command name in field 2 may contain spaces and parentheses, fields are counted from its last ')'
+    // starttime, field 22, is the 20th after it
+    const char* field = std::strrchr(stat, ')');
+    for (int i = 0; field != nullptr && i < 20; i++) {
+      field = std::strchr(field + 1, ' ');
+    }
+    timespec boot;
+    if (field == nullptr || clock_gettime(CLOCK_BOOTTIME, &boot) != 0) {
+      return std::chrono::nanoseconds(-1);
+    }
+    unsigned long long ticks = std::strtoull(field + 1, nullptr, 10);
+    long hz = sysconf(_SC_CLK_TCK);
+    auto started = std::chrono::nanoseconds(ticks * 1000000000ULL / hz);
+    return std::chrono::seconds(boot.tv_sec) + std::chrono::nanoseconds(boot.tv_nsec) - started;
+  }
+
+  // Clock that only moves when told to, for running the scheduler and the pipeline through months of uptime
+  // or millions of samples in no time. Drop-in for Monotonic wherever a class takes its clock as a template
+  // parameter; there is one fake time per process, safe to read from any thread
+  class FakeClock {
+    public:
+      using rep = int64_t;
+      using period = std::nano;
+      using duration = std::chrono::nanoseconds;
+      using time_point = std::chrono::time_point<FakeClock>;
+      static constexpr bool is_steady = true;
+
+    private:
+      static inline std::atomic<rep> s_now{0};
+
+    public:
+
+      static time_point now() {
+        return time_point(duration(s_now.load(std::memory_order_acquire)));
+      }
+
+      static void set(duration sinceEpoch) {
+        s_now.store(sinceEpoch.count(), std::memory_order_release);
+      }
+
+      static void advance(duration step) {
+        s_now.fetch_add(step.count(), std::memory_order_acq_rel);
+      }
+  };
+}
+
+#endif // __TIMING_H__
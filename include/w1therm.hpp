@@ -0,0 +1,830 @@
+#ifndef __W1THERM_H__
+#define __W1THERM_H__
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// system headers
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "timing.hpp"
+
+namespace w1 {
+
+  // Root of the w1 sysfs tree
+  constexpr const char* DEVICES_PATH = "/sys/bus/w1/devices";
+
+  // Handle on a single sysfs attribute of a w1 slave (w1_slave, temperature, ...)
+  // The file is opened once and re-read with pread() at offset 0, which makes the
+  // kernel regenerate the attribute without a new open/close per sample
+  class Sensor {
+    private:
+      std::string m_path;
+      int m_flags = O_RDONLY;
+      int m_fd = -1;
+
+      bool reopen() {
+        closeFd();
+        m_fd = open(m_path.c_str(), m_flags | O_CLOEXEC);
+        return m_fd >= 0;
+      }
+
+      void closeFd() {
+        if (m_fd >= 0) {
+          close(m_fd);
+          m_fd = -1;
+        }
+      }
+
+    public:
+
+      // flags is O_RDWR for attributes that take commands, such as therm_bulk_read
+      Sensor(const std::string& devicePath, const char* attribute = "w1_slave", int flags = O_RDONLY)
+        : m_path(devicePath + "/" + attribute), m_flags(flags) {
+        reopen();
+      }
+
+      Sensor(const Sensor&) = delete;
+      Sensor& operator=(const Sensor&) = delete;
+
+      Sensor(Sensor&& other) noexcept
+        : m_path(std::move(other.m_path)), m_flags(other.m_flags), m_fd(std::exchange(other.m_fd, -1)) {}
+
+      Sensor& operator=(Sensor&& other) noexcept {
+        if (this != &other) {
+          closeFd();
+          m_path = std::move(other.m_path);
+          m_flags = other.m_flags;
+          m_fd = std::exchange(other.m_fd, -1);
+        }
+        return *this;
+      }
+
+      const std::string& path() const {
+        return m_path;
+      }
+
+      bool isOpen() const {
+        return m_fd >= 0;
+      }
+
+      // Reads the attribute into buf (NUL terminated)
+      // Returns the number of bytes read, or -errno on failure
+      // A vanished device (ENODEV/ENOENT) drops the fd and is reopened on the next call,
+      // so a probe that gets plugged back in is picked up without restarting
+      ssize_t read(char* buf, size_t size) {
+        if (size == 0) {
+          return -EINVAL;
+        }
+        if (m_fd < 0 && !reopen()) {
+          return -errno;
+        }
+
+        ssize_t n = pread(m_fd, buf, size - 1, 0);
+        if (n < 0 && (errno == ENODEV || errno == ENOENT)) {
+          // The slave was removed and maybe re-added under the same name: retry once on a fresh fd
+          if (!reopen()) {
+            return -errno;
+          }
+          n = pread(m_fd, buf, size - 1, 0);
+        }
+        if (n < 0) {
+          int err = errno;
+          if (err == ENODEV || err == ENOENT) {
+            closeFd();
+          }
+          return -err;
+        }
+
+        buf[n] = '\0';
+        return n;
+      }
+
+      // Writes a command to the attribute, returns the number of bytes written or -errno
+      ssize_t write(const char* data, size_t size) {
+        if (m_fd < 0 && !reopen()) {
+          return -errno;
+        }
+        ssize_t n = pwrite(m_fd, data, size, 0);
+        if (n < 0) {
+          int err = errno;
+          if (err == ENODEV || err == ENOENT) {
+            closeFd();
+          }
+          return -err;
+        }
+        return n;
+      }
+
+      ~Sensor() {
+        closeFd();
+      }
+  };
+
+  enum class ParseError : uint8_t {
+    None,
+    ReadFailed,     // nothing was read (unplugged probe, timeout)
+    CrcFailed,      // w1_slave reported "crc=xx NO"
+    MissingValue,   // no "t=" field / empty attribute
+    BadValue,       // the value is not an integer
+  };
+
+  // Result of parsing a temperature attribute, no exceptions and no allocation
+  struct Temperature {
+    ParseError error = ParseError::ReadFailed;
+    int32_t milliCelsius = 0;
+
+    bool ok() const {
+      return error == ParseError::None;
+    }
+
+    double celsius() const {
+      return milliCelsius / 1000.0;
+    }
+  };
+
+  // Parses the raw bytes of either w1_therm attribute:
+  //   w1_slave    "72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57 t=23125\n"
+  //   temperature "23125\n"
+  inline Temperature parse(std::string_view text) {
+    Temperature result;
+    if (text.empty()) {
+      result.error = ParseError::ReadFailed;
+      return result;
+    }
+
+    std::string_view value = text;
+    size_t newline = text.find('\n');
+    size_t tEquals = text.find("t=", newline == std::string_view::npos ? 0 : newline);
+
+    if (newline != std::string_view::npos && tEquals != std::string_view::npos) {
+      // w1_slave: the CRC flag closes the first line
+      std::string_view line1 = text.substr(0, newline);
+      while (!line1.empty() && line1.back() == ' ') {
+        line1.remove_suffix(1);
+      }
+      if (line1.size() < 3 || line1.substr(line1.size() - 3) != "YES") {
+        result.error = ParseError::CrcFailed;
+        return result;
+      }
+      value = text.substr(tEquals + 2);
+    } else if (text.find("crc=") != std::string_view::npos) {
+      result.error = ParseError::MissingValue;
+      return result;
+    }
+
+    while (!value.empty() && value.front() == ' ') {
+      value.remove_prefix(1);
+    }
+    if (value.empty() || value.front() == '\n') {
+      result.error = ParseError::MissingValue;
+      return result;
+    }
+
+    const char* end = value.data() + value.size();
+    auto [ptr, ec] = std::from_chars(value.data(), end, result.milliCelsius);
+    if (ec != std::errc() || (ptr != end && *ptr != '\n' && *ptr != ' ')) {
+      result.milliCelsius = 0;
+      result.error = ParseError::BadValue;
+      return result;
+    }
+
+    result.error = ParseError::None;
+    return result;
+  }
+
+  enum class ReadStatus : uint8_t {
+    Skipped,    // sensor disabled for this cycle
+    Ok,         // text holds the attribute contents
+    Error,      // read failed, error holds the errno
+    Timeout,    // conversion did not finish before the sensor's deadline
+  };
+
+  struct Reading {
+    ReadStatus status = ReadStatus::Skipped;
+    int error = 0;
+    timing::Monotonic::duration elapsed{};
+    char text[128] = {};
+  };
+
+  // Reads every sensor in parallel so a cycle costs one conversion time however many probes are attached
+  // Each sensor has a persistent worker thread blocked in its read, which is where the DS18B20 conversion
+  // happens; acquire() releases all of them at once and collects the results against a per-sensor deadline
+  //
+  // Bus masters that expose therm_bulk_read get a worker too: writing "trigger" makes every probe on that bus
+  // convert at once, after which the sensor reads return without another conversion wait. A master whose
+  // trigger the kernel refuses for good is dropped and its sensors fall back to converting on their own read;
+  // after any other failure it sits out BULK_COOLDOWN, its sensors converting on their own in the meantime
+  //
+  // Handle is anything with read(char*, size_t) and write(const char*, size_t) returning bytes or -errno
+  // (Sensor on a real bus, a simulated probe in the benchmarks)
+  template <typename Handle>
+  class BasicAcquisition {
+    public:
+      using Clock = timing::Monotonic;
+
+      // Rest for a master after a trigger failed with a transient error, e.g. a reset nobody answered
+      static constexpr std::chrono::seconds BULK_COOLDOWN{30};
+
+    private:
+      struct Worker {
+        Handle handle;
+        Clock::duration timeout;
+        bool trigger = false;   // bus master: writes "trigger" to therm_bulk_read instead of reading
+        bool dead = false;      // bus master whose trigger failed for good, no longer used
+        Clock::time_point resumeAt{};   // bus master: not triggered before this, after a transient failure
+        int master = -1;        // sensor: index of its bulk capable master, -1 if none
+        std::thread thread;
+
+        // Owned by the worker while busy, read by acquire() once doneGeneration matches
+        Reading scratch;
+        bool requested = false;
+        bool busy = false;
+        uint64_t doneGeneration = 0;
+
+        Worker(Handle&& h, Clock::duration t, bool isTrigger)
+          : handle(std::move(h)), timeout(t), trigger(isTrigger) {}
+      };
+
+      std::vector<std::unique_ptr<Worker>> m_workers;   // one per sensor
+      std::vector<std::unique_ptr<Worker>> m_masters;   // one per bulk capable bus master
+      std::vector<Reading> m_readings;
+
+      // Added from another thread, running but not yet part of a cycle; acquire() takes them in
+      std::vector<std::unique_ptr<Worker>> m_stagedWorkers;
+      std::vector<std::unique_ptr<Worker>> m_stagedMasters;
+      std::function<void()> m_threadSetup;
+
+      std::mutex m_mutex;
+      std::condition_variable m_start;
+      std::condition_variable m_done;
+      uint64_t m_generation = 0;
+      size_t m_pending = 0;
+      bool m_stopping = false;
+
+      Clock::duration m_lastCycle{};
+      Clock::duration m_lastBulk{};
+
+      void run(Worker* self) {
+        Worker& worker = *self;
+        uint64_t seen = 0;
+        if (m_threadSetup) {
+          m_threadSetup();
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+          m_start.wait(lock, [&] { return m_stopping || m_generation != seen; });
+          if (m_stopping) {
+            return;
+          }
+          seen = m_generation;
+          if (!worker.requested) {
+            continue;
+          }
+          worker.requested = false;
+          worker.busy = true;
+          lock.unlock();
+
+          // Blocks for the whole conversion (the trigger write blocks for the bus's slowest probe)
+          Clock::time_point begin = Clock::now();
+          ssize_t n;
+          if (worker.trigger) {
+            static constexpr char TRIGGER[] = "trigger\n";
+            n = worker.handle.write(TRIGGER, sizeof(TRIGGER) - 1);
+            worker.scratch.text[0] = '\0';
+          } else {
+            n = worker.handle.read(worker.scratch.text, sizeof(worker.scratch.text));
+          }
+          worker.scratch.elapsed = Clock::now() - begin;
+          worker.scratch.status = n > 0 ? ReadStatus::Ok : ReadStatus::Error;
+          worker.scratch.error = n < 0 ? static_cast<int>(-n) : 0;
+
+          lock.lock();
+          worker.busy = false;
+          worker.doneGeneration = seen;
+          if (seen == m_generation && m_pending > 0) {
+            m_pending--;
+            m_done.notify_one();
+          }
+        }
+      }
+
+      void start(Worker& worker) {
+        worker.thread = std::thread(&BasicAcquisition::run, this, &worker);
+      }
+
+      // Wakes every requested worker and waits until they are done or the deadline passes
+      void release(std::unique_lock<std::mutex>& lock, Clock::time_point deadline) {
+        m_generation++;
+        m_start.notify_all();
+        m_done.wait_until(lock, deadline, [&] { return m_pending == 0; });
+      }
+
+      bool finished(const Worker& worker) const {
+        return worker.doneGeneration == m_generation && worker.scratch.elapsed <= worker.timeout;
+      }
+
+      // A sensor or master by index, whether it already takes part in cycles or is still staged; m_mutex held
+      Worker& sensorAt(size_t index) {
+        return index < m_workers.size() ? *m_workers[index] : *m_stagedWorkers[index - m_workers.size()];
+      }
+
+      Worker& masterAt(size_t index) {
+        return index < m_masters.size() ? *m_masters[index] : *m_stagedMasters[index - m_masters.size()];
+      }
+
+      // Moves the staged workers into the cycle; m_mutex held. Allocates only past the reserve()d sizes
+      void adoptStaged() {
+        for (auto& master : m_stagedMasters) {
+          m_masters.push_back(std::move(master));
+        }
+        m_stagedMasters.clear();
+        for (auto& worker : m_stagedWorkers) {
+          m_workers.push_back(std::move(worker));
+          m_readings.emplace_back();
+        }
+        m_stagedWorkers.clear();
+      }
+
+    public:
+
+      // timeout is the deadline for each sensor, measured from the start of its read
+      // threadSetup, if given, runs first on every worker thread (e.g. to give it a real-time priority)
+      BasicAcquisition(std::vector<Handle> sensors, Clock::duration timeout, std::function<void()> threadSetup = {})
+        : m_threadSetup(std::move(threadSetup)) {
+        m_workers.reserve(sensors.size());
+        for (auto& sensor : sensors) {
+          m_workers.emplace_back(std::make_unique<Worker>(std::move(sensor), timeout, false));
+        }
+        m_readings.resize(m_workers.size());
+        for (auto& worker : m_workers) {
+          start(*worker);
+        }
+      }
+
+      BasicAcquisition(const BasicAcquisition&) = delete;
+      BasicAcquisition& operator=(const BasicAcquisition&) = delete;
+
+      // Room for this many sensors and masters, so taking in the ones added later never allocates in acquire()
+      void reserve(size_t sensors, size_t masters) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_workers.reserve(sensors);
+        m_readings.reserve(sensors);
+        m_stagedWorkers.reserve(sensors);
+        m_masters.reserve(masters);
+        m_stagedMasters.reserve(masters);
+      }
+
+      // add(), addMaster(), setMaster() and setTimeout() may be called from any thread, also while a cycle runs:
+      // the worker thread is started by the caller, and the sensor or master takes part from the next acquire()
+
+      // Appends a sensor discovered at runtime, returns its index
+      size_t add(Handle&& sensor, Clock::duration timeout) {
+        auto worker = std::make_unique<Worker>(std::move(sensor), timeout, false);
+        start(*worker);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stagedWorkers.push_back(std::move(worker));
+        return m_workers.size() + m_stagedWorkers.size() - 1;
+      }
+
+      // Registers a bus master's therm_bulk_read attribute, returns the master index for setMaster()
+      size_t addMaster(Handle&& bulkRead) {
+        auto master = std::make_unique<Worker>(std::move(bulkRead), Clock::duration::zero(), true);
+        start(*master);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stagedMasters.push_back(std::move(master));
+        return m_masters.size() + m_stagedMasters.size() - 1;
+      }
+
+      // Attaches a sensor to the master whose bulk conversion covers it
+      void setMaster(size_t index, size_t master) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!masterAt(master).dead) {
+          sensorAt(index).master = static_cast<int>(master);
+        }
+      }
+
+      // Sensors in the last cycle; like reading() and temperature(), for the thread that calls acquire()
+      size_t size() const {
+        return m_workers.size();
+      }
+
+      void setTimeout(size_t index, Clock::duration timeout) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        sensorAt(index).timeout = timeout;
+      }
+
+      // Starts a conversion on every sensor flagged in enabled and waits until they are all done or past their deadline
+      // Returns the duration of the whole cycle
+      Clock::duration acquire(const std::vector<bool>& enabled) {
+        Clock::time_point begin = Clock::now();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        adoptStaged();
+
+        // A worker still stuck in an earlier read cannot take a new request
+        auto wanted = [&](size_t i) {
+          return i < enabled.size() && enabled[i] && !m_workers[i]->busy;
+        };
+
+        // Phase 1: one bulk conversion per bus, sized for the slowest enabled probe on it
+        m_pending = 0;
+        for (auto& master : m_masters) {
+          master->timeout = Clock::duration::zero();
+        }
+        for (size_t i = 0; i < m_workers.size(); i++) {
+          int m = m_workers[i]->master;
+          if (m >= 0 && wanted(i) && !m_masters[m]->dead && !m_masters[m]->busy && begin >= m_masters[m]->resumeAt) {
+            Worker& master = *m_masters[m];
+            master.timeout = std::max(master.timeout, m_workers[i]->timeout);
+            if (!master.requested) {
+              master.requested = true;
+              m_pending++;
+            }
+          }
+        }
+        uint64_t bulkGeneration = 0;
+        if (m_pending > 0) {
+          Clock::duration longest{};
+          for (auto& master : m_masters) {
+            longest = std::max(longest, master->timeout);
+          }
+          release(lock, begin + longest);
+          bulkGeneration = m_generation;
+          for (auto& master : m_masters) {
+            master->requested = false;
+          }
+        }
+        Clock::time_point bulkEnd = Clock::now();
+        m_lastBulk = bulkEnd - begin;
+
+        // Phase 2: read every sensor, those on a triggered bus only fetch the converted value
+        m_pending = 0;
+        Clock::duration longest{};
+        for (size_t i = 0; i < m_workers.size(); i++) {
+          Worker& worker = *m_workers[i];
+          worker.requested = wanted(i);
+          if (worker.requested) {
+            m_pending++;
+            longest = std::max(longest, worker.timeout);
+          }
+        }
+        release(lock, bulkEnd + longest);
+
+        Clock::time_point end = Clock::now();
+        for (size_t i = 0; i < m_workers.size(); i++) {
+          Worker& worker = *m_workers[i];
+          Reading& reading = m_readings[i];
+          bool enabledNow = i < enabled.size() && enabled[i];
+
+          if (worker.requested) {
+            // Requested but never picked up before the deadline
+            worker.requested = false;
+          }
+          if (enabledNow && finished(worker)) {
+            reading = worker.scratch;
+          } else if (enabledNow) {
+            reading.status = ReadStatus::Timeout;
+            reading.error = ETIMEDOUT;
+            reading.elapsed = end - bulkEnd;
+            reading.text[0] = '\0';
+          } else {
+            reading.status = ReadStatus::Skipped;
+            reading.error = 0;
+            reading.elapsed = Clock::duration::zero();
+            reading.text[0] = '\0';
+          }
+        }
+
+        // A master that cannot trigger (old kernel, no write access) is left to per-sensor conversions, one
+        // that failed this cycle for any other reason is tried again after the cooldown
+        for (size_t m = 0; m < m_masters.size(); m++) {
+          Worker& master = *m_masters[m];
+          if (master.dead || master.busy || bulkGeneration == 0 || master.doneGeneration != bulkGeneration ||
+              master.scratch.status != ReadStatus::Error) {
+            continue;
+          }
+          int error = master.scratch.error;
+          if (error != EACCES && error != EPERM && error != EINVAL && error != ENOENT && error != EROFS) {
+            master.resumeAt = end + BULK_COOLDOWN;
+          } else {
+            master.dead = true;
+            for (auto& worker : m_workers) {
+              if (worker->master == static_cast<int>(m)) {
+                worker->master = -1;
+              }
+            }
+          }
+        }
+
+        m_lastCycle = end - begin;
+        return m_lastCycle;
+      }
+
+      const Reading& reading(size_t index) const {
+        return m_readings[index];
+      }
+
+      // Parsed temperature of the last cycle's reading
+      Temperature temperature(size_t index) const {
+        const Reading& r = m_readings[index];
+        if (r.status != ReadStatus::Ok) {
+          return Temperature{};
+        }
+        return parse(std::string_view(r.text));
+      }
+
+      Clock::duration lastCycle() const {
+        return m_lastCycle;
+      }
+
+      // Time spent waiting on bulk conversions during the last cycle
+      Clock::duration lastBulk() const {
+        return m_lastBulk;
+      }
+
+      ~BasicAcquisition() {
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_stopping = true;
+          adoptStaged();
+        }
+        m_start.notify_all();
+        for (auto& worker : m_workers) {
+          if (worker->thread.joinable()) {
+            worker->thread.join();
+          }
+        }
+        for (auto& master : m_masters) {
+          if (master->thread.joinable()) {
+            master->thread.join();
+          }
+        }
+      }
+  };
+
+  using Acquisition = BasicAcquisition<Sensor>;
+
+  // DS18B20 resolution in bits, each step halves the conversion time
+  constexpr int MIN_RESOLUTION = 9;
+  constexpr int MAX_RESOLUTION = 12;
+
+  // Worst case conversion time from the DS18B20 datasheet: 93.75 ms at 9 bits up to 750 ms at 12 bits
+  constexpr std::chrono::microseconds conversionTime(int bits) {
+    if (bits < MIN_RESOLUTION) {
+      bits = MIN_RESOLUTION;
+    } else if (bits > MAX_RESOLUTION) {
+      bits = MAX_RESOLUTION;
+    }
+    return std::chrono::microseconds(93750) * (1 << (bits - MIN_RESOLUTION));
+  }
+
+  // Reads the w1_therm 'resolution' attribute of a slave, returns the bits or -errno
+  inline int readResolution(const std::string& devicePath) {
+    Sensor attribute(devicePath, "resolution");
+    char buffer[16];
+    ssize_t n = attribute.read(buffer, sizeof(buffer));
+    if (n < 0) {
+      return static_cast<int>(n);
+    }
+    int bits = 0;
+    auto [ptr, ec] = std::from_chars(buffer, buffer + n, bits);
+    if (ec != std::errc() || bits < MIN_RESOLUTION || bits > MAX_RESOLUTION) {
+      return -EINVAL;
+    }
+    return bits;
+  }
+
+  // Writes the w1_therm 'resolution' attribute (needs write access to sysfs), returns 0 or -errno
+  // The setting lives in the probe's scratchpad; it is lost on power loss unless saved to EEPROM
+  inline int writeResolution(const std::string& devicePath, int bits) {
+    if (bits < MIN_RESOLUTION || bits > MAX_RESOLUTION) {
+      return -EINVAL;
+    }
+    int fd = open((devicePath + "/resolution").c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0) {
+      return -errno;
+    }
+    char buffer[4];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), bits);
+    ssize_t n = write(fd, buffer, end - buffer);
+    int err = n < 0 ? errno : 0;
+    close(fd);
+    return n == end - buffer ? 0 : -(err ? err : EIO);
+  }
+
+  // w1 families handled by the w1_therm driver (DS18S20, DS1822, DS18B20, DS1825, DS28EA00)
+  inline bool isThermFamily(std::string_view id) {
+    return id.size() > 3 && id[2] == '-' &&
+      (id.substr(0, 2) == "10" || id.substr(0, 2) == "22" || id.substr(0, 2) == "28" ||
+       id.substr(0, 2) == "3b" || id.substr(0, 2) == "42");
+  }
+
+  struct SensorEntry {
+    std::string id;         // e.g. 28-000010eb7a80
+    std::string master;     // e.g. w1_bus_master1, empty if only seen under devices/
+    bool present = false;   // listed by the kernel on the last scan
+  };
+
+  // Table of every temperature sensor on every w1 bus master
+  // Entries are only ever appended, so an index stays bound to the same probe for the life of the process
+  // (a probe that goes away is kept with present = false and shows up as unplugged)
+  // Rescans are driven by kernel uevents for the w1 subsystem instead of polling sysfs every cycle;
+  // sysfs does not raise inotify events when the w1 core adds or removes slave directories
+  class Discovery {
+    public:
+      // Used when the uevent socket is unavailable (e.g. inside a container)
+      static constexpr std::chrono::seconds FALLBACK_RESCAN{30};
+
+    private:
+      std::string m_root;
+      std::vector<SensorEntry> m_table;
+      int m_uevent = -1;
+      bool m_dirty = true;
+      timing::Monotonic::time_point m_lastScan{};
+
+      SensorEntry* find(std::string_view id) {
+        for (auto& entry : m_table) {
+          if (entry.id == id) {
+            return &entry;
+          }
+        }
+        return nullptr;
+      }
+
+      void mark(std::string_view id, const std::string& master, std::vector<uint8_t>& seen) {
+        SensorEntry* entry = find(id);
+        if (entry == nullptr) {
+          m_table.push_back(SensorEntry{std::string(id), master, true});
+          seen.push_back(1);
+          return;
+        }
+        seen[entry - m_table.data()] = 1;
+        if (entry->master.empty()) {
+          entry->master = master;
+        }
+      }
+
+      // Reads the newline separated slave list of one bus master
+      void scanMaster(const std::string& master, std::vector<uint8_t>& seen) {
+        int fd = open((m_root + "/" + master + "/w1_master_slaves").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+          return;
+        }
+        char buffer[4096];
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        close(fd);
+        if (n <= 0) {
+          return;
+        }
+
+        std::string_view list(buffer, n);
+        while (!list.empty()) {
+          size_t end = list.find('\n');
+          std::string_view id = list.substr(0, end);
+          if (isThermFamily(id)) {
+            mark(id, master, seen);
+          }
+          if (end == std::string_view::npos) {
+            break;
+          }
+          list.remove_prefix(end + 1);
+        }
+      }
+
+      void scan() {
+        std::vector<uint8_t> seen(m_table.size(), 0);
+        std::vector<std::string> masters;
+        std::vector<std::string> slaves;
+
+        DIR* dir = opendir(m_root.c_str());
+        if (dir != nullptr) {
+          while (dirent* entry = readdir(dir)) {
+            std::string_view name(entry->d_name);
+            if (name.rfind("w1_bus_master", 0) == 0) {
+              masters.emplace_back(name);
+            } else if (isThermFamily(name)) {
+              slaves.emplace_back(name);
+            }
+          }
+          closedir(dir);
+        }
+
+        // Bus order first so new probes land in a deterministic slot, then anything the masters did not list
+        std::sort(masters.begin(), masters.end());
+        std::sort(slaves.begin(), slaves.end());
+        for (const auto& master : masters) {
+          scanMaster(master, seen);
+        }
+        for (const auto& slave : slaves) {
+          mark(slave, std::string(), seen);
+        }
+
+        for (size_t i = 0; i < m_table.size(); i++) {
+          m_table[i].present = seen[i] != 0;
+        }
+        m_lastScan = timing::Monotonic::now();
+        m_dirty = false;
+      }
+
+      // Drains the uevent socket, returns true if any event concerned the w1 bus
+      bool drainUevents() {
+        bool w1Event = false;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = recv(m_uevent, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+          // "add@/devices/w1_bus_master1/28-000010eb7a80" followed by NUL separated KEY=VALUE pairs
+          if (std::string_view(buffer, n).find("w1_bus_master") != std::string_view::npos) {
+            w1Event = true;
+          }
+        }
+        return w1Event;
+      }
+
+    public:
+
+      explicit Discovery(std::string root = DEVICES_PATH): m_root(std::move(root)) {
+        m_uevent = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+        if (m_uevent >= 0) {
+          sockaddr_nl addr = {};
+          addr.nl_family = AF_NETLINK;
+          addr.nl_groups = 1;   // kernel uevent multicast group
+          if (bind(m_uevent, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close(m_uevent);
+            m_uevent = -1;
+          }
+        }
+      }
+
+      Discovery(const Discovery&) = delete;
+      Discovery& operator=(const Discovery&) = delete;
+
+      const std::string& root() const {
+        return m_root;
+      }
+
+      std::string devicePath(size_t index) const {
+        return m_root + "/" + m_table[index].id;
+      }
+
+      // Bus master directory of a sensor, empty if the sensor was not listed by any master
+      std::string masterPath(size_t index) const {
+        return m_table[index].master.empty() ? std::string() : m_root + "/" + m_table[index].master;
+      }
+
+      const std::vector<SensorEntry>& sensors() const {
+        return m_table;
+      }
+
+      size_t size() const {
+        return m_table.size();
+      }
+
+      // Readable whenever the kernel reports a w1 topology change, -1 in fallback mode
+      int fd() const {
+        return m_uevent;
+      }
+
+      // Rescans the buses if something changed since the last call (or when forced)
+      // Returns the number of new entries appended to the table
+      size_t refresh(bool force = false) {
+        if (m_uevent >= 0) {
+          m_dirty |= drainUevents();
+        } else if (timing::Monotonic::now() - m_lastScan >= FALLBACK_RESCAN) {
+          m_dirty = true;
+        }
+        if (!force && !m_dirty) {
+          return 0;
+        }
+        size_t before = m_table.size();
+        scan();
+        return m_table.size() - before;
+      }
+
+      ~Discovery() {
+        if (m_uevent >= 0) {
+          close(m_uevent);
+          m_uevent = -1;
+        }
+      }
+  };
+}
+
+#endif // __W1THERM_H__
@@ -0,0 +1,1108 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <span>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "gpiochip.hpp"
+#include "pipeline.hpp"
+#include "reactor.hpp"
+#include "realtime.hpp"
+#include "rpi1306i2c.hpp"
+#include "samples.hpp"
+#include "ssd1306emu.hpp"
+#include "scheduler.hpp"
+#include "timing.hpp"
+#include "w1therm.hpp"
+
+// Offline benchmarks for the thermostat, run against fake sysfs trees so no hardware is needed
+// Usage: ./bench <mode> [options]
+
+using BenchClock = timing::Monotonic;
+
+// Results are stored here so the optimizer cannot drop the measured work
+volatile double benchSink = 0.0;
+
+const char *FAKE_W1_SLAVE =
+    "72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n"
+    "72 01 4b 46 7f ff 0e 10 57 t=23125\n";
+
+// Creates a throwaway directory with one w1 slave per sensor
+std::string makeFakeSysfs(int sensorCount, std::vector<std::string> &devices) {
+    char root[] = "/tmp/w1bench.XXXXXX";
+    if (mkdtemp(root) == nullptr) {
+        throw std::runtime_error("Could not create fake sysfs directory");
+    }
+    for (int i = 0; i < sensorCount; i++) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "28-%012x", i + 1);
+        std::string device = std::string(root) + "/" + name;
+        mkdir(device.c_str(), 0755);
+        std::ofstream(device + "/w1_slave") << FAKE_W1_SLAVE;
+        devices.push_back(device);
+    }
+    return root;
+}
+
+void removeFakeSysfs(const std::string &root, const std::vector<std::string> &devices) {
+    for (const auto &device : devices) {
+        unlink((device + "/w1_slave").c_str());
+        rmdir(device.c_str());
+    }
+    rmdir(root.c_str());
+}
+
+// The original per-cycle ifstream read, kept as the baseline
+double readTemperatureIfstream(const std::string &devicePath) {
+    std::ifstream file(devicePath + "/w1_slave");
+    std::string line1, line2;
+    if (!std::getline(file, line1) || !std::getline(file, line2)) {
+        throw std::runtime_error("Failed to read sensor file");
+    }
+    if (line1.find("YES") == std::string::npos) {
+        throw std::runtime_error("CRC check failed");
+    }
+    size_t tEqualsPosition = line2.find("t=");
+    if (tEqualsPosition == std::string::npos) {
+        throw std::runtime_error("Temperature not found");
+    }
+    return std::stoi(line2.substr(tEqualsPosition + 2)) / 1000.0;
+}
+
+double readTemperatureHandle(w1::Sensor &sensor) {
+    char buffer[128];
+    if (sensor.read(buffer, sizeof(buffer)) <= 0) {
+        throw std::runtime_error("Failed to read sensor file");
+    }
+    return w1::parse(buffer).celsius();
+}
+
+// The original getline/find/substr/stoi parser over an in-memory copy of w1_slave
+double parseTemperatureStrings(const std::string &text) {
+    std::istringstream file(text);
+    std::string line1, line2;
+    if (!std::getline(file, line1) || !std::getline(file, line2)) {
+        throw std::runtime_error("Failed to read sensor file");
+    }
+    if (line1.find("YES") == std::string::npos) {
+        throw std::runtime_error("CRC check failed");
+    }
+    size_t tEqualsPosition = line2.find("t=");
+    if (tEqualsPosition == std::string::npos) {
+        throw std::runtime_error("Temperature not found");
+    }
+    return std::stoi(line2.substr(tEqualsPosition + 2)) / 1000.0;
+}
+
+void report(const char *name, BenchClock::duration elapsed, long reads) {
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    std::printf("%-10s %10ld reads %12.1f ns/read\n", name, reads, ns / reads);
+}
+
+// Compares the ifstream path against the persistent pread() handle
+int benchSensors(int argc, char **argv) {
+    int sensorCount = argc > 0 ? std::atoi(argv[0]) : 2;
+    long iterations = argc > 1 ? std::atol(argv[1]) : 100000;
+
+    std::vector<std::string> devices;
+    std::string root = makeFakeSysfs(sensorCount, devices);
+
+    double sink = 0.0;
+    auto start = BenchClock::now();
+    for (long i = 0; i < iterations; i++) {
+        for (const auto &device : devices) {
+            sink += readTemperatureIfstream(device);
+        }
+    }
+    report("ifstream", BenchClock::now() - start, iterations * sensorCount);
+
+    std::vector<w1::Sensor> sensors;
+    for (const auto &device : devices) {
+        sensors.emplace_back(device);
+    }
+    start = BenchClock::now();
+    for (long i = 0; i < iterations; i++) {
+        for (auto &sensor : sensors) {
+            sink += readTemperatureHandle(sensor);
+        }
+    }
+    report("pread", BenchClock::now() - start, iterations * sensorCount);
+
+    removeFakeSysfs(root, devices);
+    return sink > 0 ? 0 : 1;
+}
+
+// Compares the exception based string parser with w1::parse, on good input and on a failing CRC
+int benchParse(int argc, char **argv) {
+    long iterations = argc > 0 ? std::atol(argv[0]) : 1000000;
+    const std::string good = FAKE_W1_SLAVE;
+    const std::string badCrc =
+        "72 01 4b 46 7f ff 0e 10 57 : crc=57 NO\n"
+        "72 01 4b 46 7f ff 0e 10 57 t=23125\n";
+
+    for (const std::string *input : {&good, &badCrc}) {
+        std::printf("%s input\n", input == &good ? "valid" : "bad crc");
+        double sink = 0.0;
+
+        auto start = BenchClock::now();
+        for (long i = 0; i < iterations; i++) {
+            try {
+                sink += parseTemperatureStrings(*input);
+            } catch (const std::exception &e) {
+                sink -= 1.0;
+            }
+        }
+        report("strings", BenchClock::now() - start, iterations);
+
+        start = BenchClock::now();
+        for (long i = 0; i < iterations; i++) {
+            w1::Temperature t = w1::parse(*input);
+            sink += t.ok() ? t.celsius() : -1.0;
+        }
+        report("from_chars", BenchClock::now() - start, iterations);
+        benchSink = sink;
+    }
+    return 0;
+}
+
+// Feeds w1::parse random mutations of valid attributes; build with -fsanitize=address,undefined to catch overreads
+int fuzzParse(int argc, char **argv) {
+    long iterations = argc > 0 ? std::atol(argv[0]) : 1000000;
+    unsigned seed = argc > 1 ? std::atoi(argv[1]) : std::random_device{}();
+    std::mt19937 rng(seed);
+
+    // Known answers first
+    struct Case { const char *text; w1::ParseError error; int32_t milliCelsius; };
+    const Case cases[] = {
+        {FAKE_W1_SLAVE, w1::ParseError::None, 23125},
+        {"50 05 4b 46 7f ff 0c 10 1c : crc=1c YES\n50 05 4b 46 7f ff 0c 10 1c t=-10125\n", w1::ParseError::None, -10125},
+        {"72 01 4b 46 7f ff 0e 10 57 : crc=57 NO\n72 01 4b 46 7f ff 0e 10 57 t=23125\n", w1::ParseError::CrcFailed, 0},
+        {"72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n", w1::ParseError::MissingValue, 0},
+        {"72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57 t=\n", w1::ParseError::MissingValue, 0},
+        {"72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57 t=2x\n", w1::ParseError::BadValue, 0},
+        {"23125\n", w1::ParseError::None, 23125},
+        {"-55\n", w1::ParseError::None, -55},
+        {"", w1::ParseError::ReadFailed, 0},
+    };
+    for (const Case &c : cases) {
+        w1::Temperature t = w1::parse(c.text);
+        if (t.error != c.error || t.milliCelsius != c.milliCelsius) {
+            std::printf("FAIL known case: %s\n", c.text);
+            return 1;
+        }
+    }
+
+    const std::string seeds[] = {FAKE_W1_SLAVE, "23125\n"};
+    const char alphabet[] = "0123456789abcdef -:=\ntcrYESNO\0\xff";
+    for (long i = 0; i < iterations; i++) {
+        std::string input = seeds[rng() % 2];
+        int mutations = 1 + rng() % 4;
+        for (int m = 0; m < mutations && !input.empty(); m++) {
+            size_t at = rng() % input.size();
+            switch (rng() % 3) {
+                case 0: input[at] = alphabet[rng() % (sizeof(alphabet) - 1)]; break;
+                case 1: input.erase(at, 1 + rng() % 8); break;
+                case 2: input.resize(at); break;
+            }
+        }
+        // Exact-size heap copy so ASan sees any read past the end
+        std::unique_ptr<char[]> exact(new char[input.size()]);
+        std::memcpy(exact.get(), input.data(), input.size());
+        w1::Temperature t = w1::parse(std::string_view(exact.get(), input.size()));
+        if (!t.ok() && t.milliCelsius != 0) {
+            std::printf("FAIL seed %u iteration %ld\n", seed, i);
+            return 1;
+        }
+    }
+    std::printf("fuzz: %ld inputs ok (seed %u)\n", iterations, seed);
+    return 0;
+}
+
+// One simulated w1 bus: bus transactions are serialized like the kernel's bus mutex, a conversion
+// keeps the bus only when the probes are parasite powered (strong pullup), as in w1_therm
+struct SimulatedBus {
+    std::mutex mutex;
+    bool parasite = false;
+    std::chrono::microseconds conversion{750000};
+    // Reset + match ROM + 9 byte scratchpad at ~15 kbit/s
+    std::chrono::microseconds transaction{12000};
+    std::atomic<uint64_t> bulkGeneration{0};
+
+    void convert() {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::this_thread::sleep_for(transaction / 4);
+        if (!parasite) {
+            lock.unlock();
+        }
+        std::this_thread::sleep_for(conversion);
+    }
+};
+
+// Stands in for a w1_slave attribute: converts on read unless the bus was bulk triggered
+struct SimulatedProbe {
+    SimulatedBus *bus;
+    uint64_t consumed = 0;
+
+    ssize_t read(char *buf, size_t size) {
+        uint64_t generation = bus->bulkGeneration.load();
+        if (generation == consumed) {
+            bus->convert();
+        }
+        consumed = generation;
+        std::lock_guard<std::mutex> lock(bus->mutex);
+        std::this_thread::sleep_for(bus->transaction);
+        size_t n = std::min(size - 1, std::strlen(FAKE_W1_SLAVE));
+        std::memcpy(buf, FAKE_W1_SLAVE, n);
+        buf[n] = '\0';
+        return n;
+    }
+
+    ssize_t write(const char *, size_t) {
+        return -EINVAL;
+    }
+};
+
+// Stands in for a master's therm_bulk_read attribute
+struct SimulatedBulkRead {
+    SimulatedBus *bus;
+
+    ssize_t read(char *buf, size_t size) {
+        buf[0] = '\0';
+        return size > 1 ? 0 : -EINVAL;
+    }
+
+    ssize_t write(const char *, size_t size) {
+        bus->convert();
+        bus->bulkGeneration++;
+        return size;
+    }
+};
+
+// Handle for BasicAcquisition that can be either a probe or a bulk read attribute
+struct SimulatedHandle {
+    SimulatedProbe probe;
+    bool isMaster;
+
+    ssize_t read(char *buf, size_t size) {
+        return isMaster ? SimulatedBulkRead{probe.bus}.read(buf, size) : probe.read(buf, size);
+    }
+
+    ssize_t write(const char *data, size_t size) {
+        return isMaster ? SimulatedBulkRead{probe.bus}.write(data, size) : probe.write(data, size);
+    }
+};
+
+// Average sweep time over a number of cycles, in ms
+double sweep(w1::BasicAcquisition<SimulatedHandle> &acquisition, int cycles, bool oneAtATime) {
+    size_t count = acquisition.size();
+    BenchClock::duration total{};
+    for (int c = 0; c < cycles; c++) {
+        if (oneAtATime) {
+            // The original loop: each w1_slave read in turn
+            for (size_t i = 0; i < count; i++) {
+                std::vector<bool> enabled(count, false);
+                enabled[i] = true;
+                total += acquisition.acquire(enabled);
+            }
+        } else {
+            total += acquisition.acquire(std::vector<bool>(count, true));
+        }
+    }
+    return std::chrono::duration<double, std::milli>(total).count() / cycles;
+}
+
+// Per-sweep latency of serial reads, parallel reads and therm_bulk_read for N simulated probes on one bus
+int benchSweep(int argc, char **argv) {
+    int maxSensors = argc > 0 ? std::atoi(argv[0]) : 16;
+    int cycles = argc > 1 ? std::atoi(argv[1]) : 3;
+    int bits = argc > 2 ? std::atoi(argv[2]) : 9;
+    bool parasite = argc > 3 && std::string(argv[3]) == "parasite";
+
+    auto conversion = w1::conversionTime(bits);
+    auto timeout = std::chrono::duration_cast<BenchClock::duration>(conversion) + std::chrono::seconds(5);
+
+    std::printf("%d-bit conversions, %s power, ms per sweep\n", bits, parasite ? "parasite" : "external");
+    std::printf("%8s %10s %10s %10s\n", "sensors", "serial", "parallel", "bulk");
+    for (int n = 1; n <= maxSensors; n *= 2) {
+        // A fresh bus per strategy so no bulk conversion leaks from one run into the next
+        SimulatedBus perSensorBus, bulkBus;
+        for (SimulatedBus *bus : {&perSensorBus, &bulkBus}) {
+            bus->parasite = parasite;
+            bus->conversion = conversion;
+        }
+
+        std::vector<SimulatedHandle> handles;
+        for (int i = 0; i < n; i++) {
+            handles.push_back(SimulatedHandle{SimulatedProbe{&perSensorBus}, false});
+        }
+        w1::BasicAcquisition<SimulatedHandle> perSensor(std::move(handles), timeout);
+        double serial = sweep(perSensor, cycles, true);
+        double parallel = sweep(perSensor, cycles, false);
+
+        handles.clear();
+        for (int i = 0; i < n; i++) {
+            handles.push_back(SimulatedHandle{SimulatedProbe{&bulkBus}, false});
+        }
+        w1::BasicAcquisition<SimulatedHandle> bulkRead(std::move(handles), timeout);
+        size_t master = bulkRead.addMaster(SimulatedHandle{SimulatedProbe{&bulkBus}, true});
+        for (int i = 0; i < n; i++) {
+            bulkRead.setMaster(i, master);
+        }
+        double bulk = sweep(bulkRead, cycles, false);
+
+        std::printf("%8d %10.1f %10.1f %10.1f\n", n, serial, parallel, bulk);
+    }
+    return 0;
+}
+
+// CPU time used by this process so far
+double cpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void reportIdle(const char *name, double cpu, double seconds, uint64_t wakeups, uint64_t ticks) {
+    double hours = seconds / 3600.0;
+    std::printf("%-8s %10.1f s CPU/hour %14.0f wakeups/hour (%lu ticks)\n", name, cpu / hours, wakeups / hours, ticks);
+}
+
+// CPU time and wakeups of the old busy-polling loop against the epoll loop, both ticking once per second
+int benchIdle(int argc, char **argv) {
+    int seconds = argc > 0 ? std::atoi(argv[0]) : 10;
+    auto period = std::chrono::seconds(1);
+
+    // Before: compare the clock against the last read time in a tight loop, like the original main()
+    double cpu = cpuSeconds();
+    uint64_t passes = 0, ticks = 0;
+    auto start = BenchClock::now();
+    auto lastRead = start;
+    while (BenchClock::now() - start < std::chrono::seconds(seconds)) {
+        passes++;
+        if (BenchClock::now() - lastRead >= period) {
+            lastRead = BenchClock::now();
+            ticks++;
+        }
+    }
+    reportIdle("polling", cpuSeconds() - cpu, seconds, passes, ticks);
+
+    // After: sleep in epoll_wait on a timerfd
+    event::Loop loop;
+    event::Timer tick, done;
+    tick.setPeriod(period);
+    done.set(std::chrono::seconds(seconds), std::chrono::nanoseconds(0));
+    ticks = 0;
+    loop.add(tick.fd(), EPOLLIN, [&](uint32_t) {
+        ticks += tick.consume();
+    });
+    loop.add(done.fd(), EPOLLIN, [&](uint32_t) {
+        loop.stop();
+    });
+    cpu = cpuSeconds();
+    loop.run();
+    reportIdle("epoll", cpuSeconds() - cpu, seconds, loop.wakeups(), ticks);
+    return 0;
+}
+
+void reportJitter(const char *name, const scheduler::Histogram &error, BenchClock::duration span, int cycles) {
+    auto ms = [](std::chrono::nanoseconds d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    std::printf("%-9s interval %8.3f ms  late vs grid: p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n", name,
+                ms(span) / (cycles - 1), ms(error.percentile(0.5)), ms(error.percentile(0.99)), ms(error.max()));
+}
+
+// Start times of every cycle against the ideal grid start + k * period, with work standing in for the
+// conversions and the upload: the old schedule (next read one period after the previous one finished)
+// against absolute clock_nanosleep deadlines
+int benchJitter(int argc, char **argv) {
+    auto period = std::chrono::milliseconds(argc > 0 ? std::atoi(argv[0]) : 100);
+    int cycles = std::max(2, argc > 1 ? std::atoi(argv[1]) : 50);
+    auto work = std::chrono::milliseconds(argc > 2 ? std::atoi(argv[2]) : 20);
+
+    // Before: sleep a period after the work, so every cycle is late by all the work before it
+    scheduler::Histogram relative;
+    auto start = BenchClock::now();
+    auto first = start, last = start;
+    for (int i = 0; i < cycles; i++) {
+        last = BenchClock::now();
+        relative.record(last - (start + i * period));
+        std::this_thread::sleep_for(work);
+        std::this_thread::sleep_for(period);
+    }
+    reportJitter("relative", relative, last - first, cycles);
+
+    // After: sleep until the next deadline on the grid
+    scheduler::Histogram absolute;
+    scheduler::Deadlines deadlines(period);
+    start = BenchClock::now() + period;
+    deadlines.start(start);
+    for (int i = 0; i < cycles; i++) {
+        scheduler::sleepUntil(deadlines.next());
+        last = BenchClock::now();
+        if (i == 0) {
+            first = last;
+        }
+        absolute.record(last - (start + i * period));
+        std::this_thread::sleep_for(work);
+        deadlines.advance(BenchClock::now());
+    }
+    reportJitter("deadline", absolute, last - first, cycles);
+    if (deadlines.missed() > 0) {
+        std::printf("%lu deadlines missed, work does not fit in the period\n", deadlines.missed());
+    }
+    return 0;
+}
+
+// Wakeup latency of a thread sampling on absolute deadlines, like the sampling thread, for seconds
+// With profile enabled the thread applies it first; prints the error and runs anyway if that fails
+void sampleUnderLoad(int seconds, std::chrono::milliseconds period, const rt::Profile &profile,
+                     scheduler::Histogram &latency) {
+    std::thread sampler([&] {
+        if (profile.enabled()) {
+            int err = rt::lockMemory();
+            if (err == 0) {
+                err = rt::enter(profile);
+            }
+            if (err < 0) {
+                std::printf("real-time profile not applied: %s\n", std::strerror(-err));
+            }
+        }
+        scheduler::Deadlines deadlines(period);
+        auto end = BenchClock::now() + std::chrono::seconds(seconds);
+        deadlines.start(BenchClock::now() + period);
+        while (deadlines.next() < end) {
+            scheduler::sleepUntil(deadlines.next());
+            latency.record(BenchClock::now() - deadlines.next());
+            deadlines.advance(BenchClock::now());
+        }
+    });
+    sampler.join();
+}
+
+// Worst-case sample latency with the real-time profile off and on while every core is busy. The load is
+// generated locally, like stress-ng --cpu --vm: two spinning threads per core and one faulting in fresh memory
+int benchStress(int argc, char **argv) {
+    int seconds = argc > 0 ? std::atoi(argv[0]) : 10;
+    rt::Profile profile;
+    profile.priority = argc > 1 ? std::atoi(argv[1]) : 80;
+    profile.cpu = argc > 2 ? std::atoi(argv[2]) : -1;
+    auto period = std::chrono::milliseconds(argc > 3 ? std::atoi(argv[3]) : 10);
+
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> load;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < 2 * cores; i++) {
+        load.emplace_back([&] {
+            volatile uint64_t spin = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                spin = spin + 1;
+            }
+        });
+    }
+    load.emplace_back([&] {
+        const size_t BLOCK = 64 << 20;
+        while (!stop.load(std::memory_order_relaxed)) {
+            std::unique_ptr<char[]> block(new char[BLOCK]);
+            for (size_t i = 0; i < BLOCK; i += 4096) {
+                block[i] = 1;
+            }
+            benchSink = block[BLOCK / 2];
+        }
+    });
+    std::printf("%u load threads on %u cores, sampling every %ld ms for %d s per run\n",
+                2 * cores + 1, cores, (long)period.count(), seconds);
+
+    auto ms = [](std::chrono::nanoseconds d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    auto report = [&](const char *name, const scheduler::Histogram &latency) {
+        std::printf("%-9s p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms  (%lu samples)\n", name,
+                    ms(latency.percentile(0.5)), ms(latency.percentile(0.99)), ms(latency.max()), latency.count());
+    };
+    // Memory stays locked once the profile is applied, so the normal run goes first
+    scheduler::Histogram normal, realtime;
+    sampleUnderLoad(seconds, period, rt::Profile{}, normal);
+    report("normal", normal);
+    sampleUnderLoad(seconds, period, profile, realtime);
+    report("realtime", realtime);
+
+    stop = true;
+    for (std::thread &thread : load) {
+        thread.join();
+    }
+    return 0;
+}
+
+// Drives the scheduler and the pipeline with timing::FakeClock through the cases a real clock cannot reach
+// quickly: the 49.7 day point where 32-bit millis() wrapped, months of uptime, and high-rate sampling
+int checkClock(int argc, char **argv) {
+    long samples = argc > 0 ? std::atol(argv[0]) : 1000000;
+    using Fake = timing::FakeClock;
+    const auto MILLIS_WRAP = std::chrono::milliseconds(1ULL << 32);
+
+    // Once a second across the old wraparound: every deadline exactly one period after the last
+    Fake::set(MILLIS_WRAP - std::chrono::seconds(10));
+    scheduler::BasicDeadlines<Fake> deadlines(std::chrono::seconds(1));
+    deadlines.start(Fake::now());
+    auto previous = deadlines.next();
+    for (int i = 0; i < 20; i++) {
+        Fake::advance(std::chrono::milliseconds(900));
+        auto next = deadlines.advance(Fake::now());
+        if (next - previous != std::chrono::seconds(1) || deadlines.missed() != 0) {
+            std::printf("FAIL wraparound: deadline %d is %ld ns after the last\n", i, (long)(next - previous).count());
+            return 1;
+        }
+        Fake::set(next.time_since_epoch());
+        previous = next;
+    }
+
+    // A year at 1 Hz with 750 ms conversions: the grid must not drift by a single nanosecond
+    const long YEAR_TICKS = 365L * 24 * 3600;
+    Fake::set(std::chrono::nanoseconds(0));
+    scheduler::BasicDeadlines<Fake> year(std::chrono::seconds(1));
+    year.start(Fake::now());
+    for (long i = 0; i < YEAR_TICKS; i++) {
+        Fake::set(year.next().time_since_epoch() + std::chrono::milliseconds(750));
+        year.advance(Fake::now());
+    }
+    if (year.next().time_since_epoch() != std::chrono::seconds(YEAR_TICKS) || year.missed() != 0) {
+        std::printf("FAIL year: last deadline off by %ld ns\n",
+                    (long)(year.next().time_since_epoch() - std::chrono::seconds(YEAR_TICKS)).count());
+        return 1;
+    }
+
+    // 10 kHz with random lateness, a few cycles overrunning by whole periods: missed deadlines are counted
+    // exactly and the histogram percentiles stay within its 12.5% bucket width
+    std::mt19937 rng(1);
+    const auto PERIOD = std::chrono::microseconds(100);
+    scheduler::BasicDeadlines<Fake> fast(PERIOD);
+    scheduler::Histogram jitter;
+    std::vector<long> lateness;
+    uint64_t expectMissed = 0;
+    fast.start(Fake::now());
+    for (long i = 0; i < samples; i++) {
+        long late = rng() % 50000;
+        Fake::set(fast.next().time_since_epoch() + std::chrono::nanoseconds(late));
+        jitter.record(Fake::now() - fast.next());
+        lateness.push_back(late);
+        auto work = std::chrono::microseconds(rng() % 1000 == 0 ? 350 : 20);
+        Fake::advance(work);
+        expectMissed += (late + std::chrono::nanoseconds(work).count()) / std::chrono::nanoseconds(PERIOD).count();
+        fast.advance(Fake::now());
+    }
+    std::sort(lateness.begin(), lateness.end());
+    for (double fraction : {0.5, 0.99}) {
+        long exact = lateness[std::max<long>(0, std::ceil(fraction * samples) - 1)];
+        long measured = jitter.percentile(fraction).count();
+        if (measured < exact || measured > exact * 1.125 + 1) {
+            std::printf("FAIL p%.0f: histogram %ld ns, exact %ld ns\n", fraction * 100, measured, exact);
+            return 1;
+        }
+    }
+    if (fast.missed() != expectMissed || jitter.max().count() != lateness.back()) {
+        std::printf("FAIL high rate: %lu missed, expected %lu\n", fast.missed(), expectMissed);
+        return 1;
+    }
+
+    // A period change decided during a cycle (a probe plugged in at another resolution) and applied after
+    // advance(), as the sampling thread does: the next deadline is one new period after the one served
+    for (auto [from, to] : {std::pair{244, 900}, std::pair{1000, 250}}) {
+        Fake::set(std::chrono::seconds(100));
+        scheduler::BasicDeadlines<Fake> changing{std::chrono::milliseconds(from)};
+        changing.start(Fake::now());
+        for (int i = 0; i < 3; i++) {
+            auto served = changing.next();
+            Fake::set(served.time_since_epoch() + std::chrono::milliseconds(120));
+            changing.advance(Fake::now());
+            if (i == 1) {
+                changing.setPeriod(std::chrono::milliseconds(to));
+            }
+            auto expected = std::chrono::milliseconds(i >= 1 ? to : from);
+            if (changing.next() - served != expected || changing.missed() != 0) {
+                std::printf("FAIL period %d -> %d ms: next deadline %ld ms after the served one, %lu missed\n", from,
+                            to, (long)std::chrono::duration_cast<std::chrono::milliseconds>(changing.next() - served).count(),
+                            changing.missed());
+                return 1;
+            }
+        }
+    }
+
+    // Pipeline latencies on the fake clock: every sample converts for 750 ms, then waits exactly 3 ms for the
+    // stage, which is all the latency should show
+    samples::Ring<1024> ring;
+    std::atomic<long> seen{0};
+    {
+        pipeline::Stage<1024, Fake> stage(ring, [&](const samples::Sample &) { seen++; }, [] {});
+        for (int i = 0; i < 100; i++) {
+            samples::Sample sample;
+            sample.monotonicNs = timing::nowNanos<Fake>();
+            Fake::advance(std::chrono::milliseconds(750));
+            sample.publishedNs = timing::nowNanos<Fake>();
+            ring.push(sample);
+            Fake::advance(std::chrono::milliseconds(3));
+            stage.notify();
+            while (seen.load() <= i) {
+                std::this_thread::yield();
+            }
+            Fake::advance(std::chrono::milliseconds(7));
+        }
+        if (stage.latency().max() != std::chrono::milliseconds(3) || stage.latency().mean() != std::chrono::milliseconds(3)) {
+            std::printf("FAIL stage latency: %ld ns max\n", (long)stage.latency().max().count());
+            return 1;
+        }
+    }
+
+    // Rate cap: a burst of notifications is coalesced into at most two passes, and no sample is skipped
+    {
+        std::atomic<long> passes{0}, drained{0};
+        pipeline::Stage<1024> stage(ring, [&](const samples::Sample &) { drained++; }, [&] { passes++; });
+        stage.setMinInterval(std::chrono::milliseconds(50));
+        for (int i = 0; i < 500; i++) {
+            ring.push(samples::Sample{});
+            stage.notify();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        if (passes.load() > 2 || drained.load() != 500) {
+            std::printf("FAIL rate cap: %ld passes, %ld of 500 samples\n", passes.load(), drained.load());
+            return 1;
+        }
+    }
+
+    std::printf("clock: wraparound, %ld ticks over a year, %ld samples at 10 kHz (p50 %ld ns, p99 %ld ns, %lu missed), period changes, stage latency and rate cap ok\n",
+                YEAR_TICKS, samples, (long)jitter.percentile(0.5).count(), (long)jitter.percentile(0.99).count(), fast.missed());
+    return 0;
+}
+
+// Stand-in for i2c::Device that counts what a transfer would cost: one I2C_RDWR ioctl per call
+struct CountingBus {
+    uint64_t syscalls = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+
+    int transfer(std::span<const i2c::Message> sent) {
+        syscalls += (sent.size() + i2c::MAX_MESSAGES - 1) / i2c::MAX_MESSAGES;
+        for (const auto &message : sent) {
+            messages++;
+            bytes += message.size;
+        }
+        return 0;
+    }
+};
+
+// The same messages sent the way the old 128-byte buffer did: a write() per command message, and data cut
+// into 128-byte writes, each after the first starting over with a 0x40 control byte
+struct LegacyBus: CountingBus {
+    int transfer(std::span<const i2c::Message> sent) {
+        for (const auto &message : sent) {
+            if (message.data[0] != 0x40) {
+                syscalls++;
+                messages++;
+                bytes += message.size;
+                continue;
+            }
+            size_t fill = 1;
+            for (size_t i = 1; i < message.size; i++) {
+                if (++fill == 128) {
+                    syscalls++;
+                    messages++;
+                    bytes += fill;
+                    fill = 1;
+                }
+            }
+            syscalls++;
+            messages++;
+            bytes += fill;
+        }
+        return 0;
+    }
+};
+
+template <typename Display>
+void fillFrame(Display &display, uint8_t seed) {
+    for (uint8_t page = 0; page < display.height() / 8; page++) {
+        for (uint8_t x = 0; x < display.width(); x++) {
+            display.setByte(page, x, seed + page * 131 + x);
+        }
+    }
+}
+
+// Bus cost of one flush() after update, starting from a flushed frame
+template <typename Display, typename Update>
+CountingBus flushCost(Display &display, Update update) {
+    display.flush();
+    display.bus() = {};
+    update(display);
+    display.flush();
+    return display.bus();
+}
+
+template <uint8_t Width, uint8_t Height>
+void benchPanel(long iterations) {
+    ssd1306::Display<Width, Height, CountingBus> display;
+    ssd1306::Display<Width, Height, LegacyBus> legacy;
+    std::string size = std::to_string(Width) + "x" + std::to_string(Height);
+    const char *name = size.c_str();
+    int rows = display.height() / 8;
+    auto fullFrame = [](auto &d) { fillFrame(d, 1); };
+    auto textLines = [rows](auto &d) {
+        for (int row = 0; row < rows; row++) {
+            d.drawString(0, row * 8, "Sensor " + std::to_string(row) + ": 21.4C    ");
+        }
+    };
+    auto oneDigit = [](auto &d) { d.drawString(6, 0, "7"); };
+    auto report = [&](const char *what, auto update) {
+        fillFrame(display, 0);
+        fillFrame(legacy, 0);
+        CountingBus before = flushCost(legacy, update), after = flushCost(display, update);
+        std::printf("%s %-10s write()/frame %4lu -> %lu ioctl   bus transactions %4lu -> %lu   bytes %5lu -> %lu\n",
+                    name, what, before.syscalls, after.syscalls, before.messages, after.messages, before.bytes, after.bytes);
+    };
+    // Init: the old code wrote every command byte as its own 2-byte transaction
+    uint64_t initCommands = display.bus().bytes - 1;
+    auto busMicros = [](uint64_t messages, uint64_t bytes) { return (messages + bytes) * 9 * 1e6 / 400000; };
+    std::printf("%s init       write()/frame %4lu -> %lu        bus transactions %4lu -> %lu   bytes %5lu -> %lu"
+                "   (%.0f -> %.0f us at 400 kHz)\n", name, initCommands, display.bus().syscalls, initCommands,
+                display.bus().messages, 2 * initCommands, display.bus().bytes,
+                busMicros(initCommands, 2 * initCommands), busMicros(display.bus().messages, display.bus().bytes));
+    report("full frame", fullFrame);
+    report("text", textLines);
+    report("one digit", oneDigit);
+
+    // Text layer: only the cells whose character changed are drawn, where the old padded line redrew the whole row
+    ssd1306::TextLayer<decltype(display)> text(display);
+    text.invalidate();
+    text.print(0, "Sensor 1: 23.41 C");
+    for (const char *line : {"Sensor 1: 23.44 C", "Sensor 1: OFF"}) {
+        uint64_t glyphs = text.glyphs();
+        CountingBus cost = flushCost(display, [&](auto &) { text.print(0, line); });
+        std::printf("%s text layer -> \"%s\": %lu of %d cells drawn, %lu bytes\n", name, line, text.glyphs() - glyphs,
+                    text.columns(), cost.bytes);
+    }
+
+    auto start = BenchClock::now();
+    for (long i = 0; i < iterations; i++) {
+        fillFrame(display, i);
+        display.flush();
+    }
+    double ns = std::chrono::duration<double, std::nano>(BenchClock::now() - start).count() / iterations;
+    std::printf("%s full-frame draw+flush on the counting bus: %.0f ns\n", name, ns);
+}
+
+// Syscalls, bus transactions and bytes per frame for the SSD1306 flush, against buses that only count:
+// the old 128-byte buffered writes against one I2C_RDWR per flush with the whole window in one message
+int benchDisplay(int argc, char **argv) {
+    long iterations = argc > 0 ? std::atol(argv[0]) : 10000;
+    benchPanel<128, 32>(iterations);
+    benchPanel<128, 64>(iterations);
+    benchPanel<72, 40>(iterations);
+    benchPanel<64, 48>(iterations);
+
+    // Compile-time labels: the same pixels as the glyph path, drawn with a copy instead of a walk through the font
+    static constexpr auto UNPLUGGED = ssd1306::label("Sensor 1: Unplugged");
+    static constexpr auto OFF = ssd1306::label("Sensor 1: OFF      ");
+    ssd1306::Display<128, 32, CountingBus> glyphs, labels;
+    glyphs.drawString(0, 8, UNPLUGGED.text);
+    labels.drawLabel(0, 8, UNPLUGGED);
+    for (uint8_t x = 0; x < glyphs.width(); x++) {
+        if (glyphs.byteAt(1, x) != labels.byteAt(1, x)) {
+            std::printf("FAIL label: column %u differs from the glyph path\n", x);
+            return 1;
+        }
+    }
+    auto time = [&](auto draw) {
+        auto start = BenchClock::now();
+        for (long i = 0; i < iterations; i++) {
+            draw(i & 1);
+        }
+        return std::chrono::duration<double, std::nano>(BenchClock::now() - start).count() / iterations;
+    };
+    double glyphNs = time([&](bool odd) { glyphs.drawString(0, 8, odd ? OFF.text : UNPLUGGED.text); });
+    double labelNs = time([&](bool odd) { odd ? labels.drawLabel(0, 8, OFF) : labels.drawLabel(0, 8, UNPLUGGED); });
+    benchSink = benchSink + glyphs.byteAt(1, 0) + labels.byteAt(1, 0);
+    std::printf("19-character line into the framebuffer: %.0f ns through the font, %.0f ns as a label\n", glyphNs, labelNs);
+
+    // A four-line log on the 128x32 panel taking a new line: every row redrawn one row up, against drawing
+    // only the new line into the off-screen half of the GDDRAM and rolling it in with the start line
+    {
+        ssd1306::Display<128, 32, CountingBus> redraw, rolled;
+        const int LINES = 100;
+        uint64_t redrawBytes = 0, rolledBytes = 0;
+        auto line = [](int n) { return "Event " + std::to_string(n) + ": sensor " + std::to_string(n % 4 + 1) + " 21.4C"; };
+        for (int n = 0; n < LINES; n++) {
+            redrawBytes += flushCost(redraw, [&](auto &d) {
+                for (int row = 0; row < 4; row++) {
+                    d.clear(0, row * 8, d.width(), 8);
+                    if (n - 3 + row >= 0) {
+                        d.drawString(0, row * 8, line(n - 3 + row));
+                    }
+                }
+            }).bytes;
+            rolledBytes += flushCost(rolled, [&](auto &d) {
+                // The new bottom row is the page just below the four on screen
+                uint8_t page = (d.startLine() / 8 + 4) % 8;
+                d.clear(0, page * 8, d.width(), 8);
+                d.drawString(0, page * 8, line(n));
+            }).bytes;
+            rolled.bus() = {};
+            rolled.setStartLine(rolled.startLine() + 8);
+            rolledBytes += rolled.bus().bytes;
+        }
+        // The continuous scroll is a single command stream however long it runs
+        rolled.bus() = {};
+        rolled.startScroll(ssd1306::Scroll::Left, 0, 3, ssd1306::ScrollInterval::Frames5);
+        rolled.stopScroll();
+        std::printf("log line on 128x32: %lu bytes redrawing the rows, %lu rolling the start line (scroll start+stop: %lu)\n",
+                    redrawBytes / LINES, rolledBytes / LINES, rolled.bus().bytes);
+    }
+
+    // Sparklines on a slow drift with noise, like a room temperature: I2C bytes per new sample, and the cost
+    // of shifting in one column against recomputing the whole graph
+    for (auto [width, height] : {std::pair{18, 8}, std::pair{128, 32}}) {
+        ssd1306::Display<128, 32, CountingBus> panel;
+        ssd1306::Sparkline<decltype(panel)> trend(panel, 128 - width, 0, width, height);
+        std::mt19937 rng(1);
+        auto celsius = [&](long i) { return 21 + 2 * std::sin(i / 100.0f) + (rng() % 100) / 1000.0f; };
+        const int SAMPLES = 1000;
+        uint64_t bytes = 0;
+        for (int i = 0; i < SAMPLES; i++) {
+            bytes += flushCost(panel, [&](auto &) { trend.push(celsius(i)); }).bytes;
+        }
+        double pushNs = time([&](bool) { trend.push(celsius(SAMPLES)); });
+        double redrawNs = time([&](bool) { trend.redraw(); });
+        std::printf("%dx%d sparkline: %lu bytes per sample, %.0f ns to shift one in, %.0f ns to redraw\n", width, height,
+                    bytes / SAMPLES, pushNs, redrawNs);
+    }
+    return 0;
+}
+
+// Pixels the emulated panel shows against the ones the framebuffer says it should, with the start line applied
+template <typename Panel>
+bool matchesFramebuffer(const char *what, Panel &display) {
+    const ssd1306::Emulator &panel = display.bus();
+    for (uint8_t y = 0; y < display.height(); y++) {
+        uint8_t row = (panel.startLine() + y) & 63;
+        for (uint8_t x = 0; x < display.width(); x++) {
+            bool expected = (display.byteAt(row >> 3, x) >> (row & 7)) & 1;
+            if (panel.pixel(x, y) != expected) {
+                std::printf("FAIL %s: pixel (%u, %u) is %s on the emulated panel\n", what, x, y, expected ? "off" : "on");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Panel>
+bool snapshot(const char *what, Panel &display, const std::string &dir) {
+    const ssd1306::Emulator::Counters &sent = display.bus().counters();
+    std::printf("%-10s %3ux%-2u %lu transfers, %lu messages, %5lu bytes (%lu data)\n", what, display.width(),
+                display.height(), sent.transfers, sent.messages, sent.bytes, sent.dataBytes);
+    display.bus().resetCounters();
+    if (!matchesFramebuffer(what, display)) {
+        return false;
+    }
+    if (!dir.empty()) {
+        int err = display.bus().writePbm(dir + "/" + what + ".pbm");
+        if (err < 0) {
+            std::printf("Could not write %s/%s.pbm: %s\n", dir.c_str(), what, std::strerror(-err));
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs the display code against the SSD1306 emulator: every frame the emulated GDDRAM shows must match the
+// framebuffer pixel for pixel, and each one can be saved as a PBM under dir to eyeball or diff
+int renderFrames(int argc, char **argv) {
+    std::string dir = argc > 0 ? argv[0] : "";
+    using Panel = ssd1306::Display<128, 32, ssd1306::Emulator>;
+
+    // The dashboard: labels, digits and trends
+    Panel dashboard;
+    if (!snapshot("init", dashboard, dir)) {
+        return 1;
+    }
+    ssd1306::TextLayer<Panel> text(dashboard);
+    static constexpr auto SENSOR = ssd1306::label("Sensor 1: ");
+    static constexpr auto CELSIUS = ssd1306::label(" C");
+    ssd1306::Sparkline<Panel> trend(dashboard, 110, 0, 18, 8);
+    for (int i = 0; i < 30; i++) {
+        trend.push(21 + std::sin(i / 4.0f));
+    }
+    text.end(0, text.put(0, text.put(0, text.put(0, 0, SENSOR), "21.43"), CELSIUS));
+    text.print(1, "Sensor 2: Unplugged");
+    text.print(2, "Sensor 3: OFF");
+    dashboard.flush();
+    if (!snapshot("dashboard", dashboard, dir)) {
+        return 1;
+    }
+    text.put(0, 10, "21.44");
+    trend.update(21.2f);
+    dashboard.flush();
+    if (!snapshot("digit", dashboard, dir)) {
+        return 1;
+    }
+
+    // Graphics on the tall panel
+    ssd1306::Display<128, 64, ssd1306::Emulator> graphics;
+    graphics.drawLine(0, 0, 127, 63);
+    graphics.drawLine(0, 63, 127, 0);
+    graphics.fillRect(10, 20, 12, 30);
+    graphics.fillRect(100, 5, 20, 3);
+    graphics.flush();
+    if (!snapshot("graphics", graphics, dir)) {
+        return 1;
+    }
+
+    // A narrow panel, drawn in the middle columns of the RAM
+    ssd1306::Display<72, 40, ssd1306::Emulator> narrow(72);
+    ssd1306::TextLayer<decltype(narrow)> narrowText(narrow);
+    narrowText.print(0, "72x40 panel");
+    narrowText.print(4, "last row");
+    narrow.flush();
+    if (!snapshot("narrow", narrow, dir)) {
+        return 1;
+    }
+
+    // Rolling a log through the off-screen RAM with the start line
+    Panel log;
+    for (int n = 0; n < 6; n++) {
+        uint8_t page = (log.startLine() / 8 + 4) % 8;
+        log.clear(0, page * 8, log.width(), 8);
+        log.drawString(0, page * 8, "log line " + std::to_string(n));
+        log.flush();
+        log.setStartLine(log.startLine() + 8);
+    }
+    if (!snapshot("rolled", log, dir)) {
+        return 1;
+    }
+
+    // A controller that resets while the bus refuses a few transfers: in Recover mode the frame is dropped
+    // without an exception, the next flush() replays the init sequence with the start line and sends everything
+    log.setErrorHandling(ssd1306::OnError::Recover, 3, std::chrono::microseconds(0));
+    log.bus().powerCycle();
+    log.bus().failNext(4);
+    log.drawString(0, (log.startLine() / 8 + 3) % 8 * 8, "after glitch");
+    log.flush();
+    ssd1306::BusErrors errors = log.errors();
+    if (!log.lost() || errors.failed != 1 || errors.retries != 2 || errors.dropped != 1) {
+        std::printf("FAIL glitch: lost %d, %lu failed, %lu retries, %lu dropped\n", log.lost(), errors.failed,
+                    errors.retries, errors.dropped);
+        return 1;
+    }
+    log.bus().resetCounters();
+    log.flush();
+    if (log.lost() || log.errors().reinits != 1 || !snapshot("recovered", log, dir)) {
+        std::printf("FAIL recovered: lost %d, %lu reinits\n", log.lost(), log.errors().reinits);
+        return 1;
+    }
+
+    // The default still throws, after the same retries
+    Panel strict;
+    strict.setErrorHandling(ssd1306::OnError::Throw, 2, std::chrono::microseconds(0));
+    strict.bus().failNext(2);
+    strict.fillRect(0, 0, 8, 8);
+    try {
+        strict.flush();
+        std::printf("FAIL strict: no exception after the last attempt\n");
+        return 1;
+    } catch (const std::runtime_error &) {
+    }
+
+    // No adapter at all, like a Pi booted without the panel's bus: in Recover mode with Open::Retry neither the
+    // constructor nor a flush() throws, and each reinit() tries to open the adapter again
+    ssd1306::Display<128, 32> absent(ssd1306::OnError::Recover, 250, 0x3C, i2c::Open::Retry);
+    absent.setErrorHandling(ssd1306::OnError::Recover, 2, std::chrono::microseconds(0));
+    absent.drawString(0, 0, "nobody home");
+    absent.flush();
+    if (!absent.lost() || absent.bus().isOpen() || absent.errors().reinits != 1) {
+        std::printf("FAIL absent: lost %d, %lu reinits\n", absent.lost(), absent.errors().reinits);
+        return 1;
+    }
+    std::printf("render: all frames match the framebuffer%s%s\n", dir.empty() ? "" : ", PBMs in ", dir.c_str());
+    return 0;
+}
+
+// Prints edges on one line with their kernel timestamps, e.g. against a gpio-sim chip:
+//   modprobe gpio-sim, create a bank through configfs, then toggle its pull in sysfs
+int benchGpio(int argc, char **argv) {
+    std::string chip = argc > 0 ? argv[0] : gpio::DEFAULT_CHIP;
+    uint32_t line = argc > 1 ? std::atoi(argv[1]) : 0;
+    int count = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    gpio::Lines lines(chip, {line}, gpio::Edge::Both, gpio::Bias::PullUp, std::chrono::microseconds(1000));
+    event::Loop loop;
+    uint64_t previous = 0;
+    int seen = 0;
+    loop.add(lines.fd(), EPOLLIN, [&](uint32_t) {
+        gpio::Event edge;
+        while (lines.read(edge)) {
+            std::printf("%s edge on line %u at %lu ns (+%lu ns) seqno %u\n", edge.rising ? "rising" : "falling",
+                        edge.line, edge.timestampNs, previous ? edge.timestampNs - previous : 0, edge.seqno);
+            previous = edge.timestampNs;
+            if (++seen >= count) {
+                loop.stop();
+            }
+        }
+    });
+    std::printf("Waiting for %d edges on %s line %u\n", count, chip.c_str(), line);
+    loop.run();
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "sensors") {
+        return benchSensors(argc - 2, argv + 2);
+    } else if (mode == "parse") {
+        return benchParse(argc - 2, argv + 2);
+    } else if (mode == "fuzz-parse") {
+        return fuzzParse(argc - 2, argv + 2);
+    } else if (mode == "sweep") {
+        return benchSweep(argc - 2, argv + 2);
+    } else if (mode == "idle") {
+        return benchIdle(argc - 2, argv + 2);
+    } else if (mode == "gpio") {
+        return benchGpio(argc - 2, argv + 2);
+    } else if (mode == "jitter") {
+        return benchJitter(argc - 2, argv + 2);
+    } else if (mode == "clock") {
+        return checkClock(argc - 2, argv + 2);
+    } else if (mode == "stress") {
+        return benchStress(argc - 2, argv + 2);
+    } else if (mode == "display") {
+        return benchDisplay(argc - 2, argv + 2);
+    } else if (mode == "render") {
+        return renderFrames(argc - 2, argv + 2);
+    }
+
+    std::cerr << "Usage: " << argv[0] << " <mode> [options]" << std::endl;
+    std::cerr << "  sensors [count] [iterations]   ifstream vs pread sensor reads" << std::endl;
+    std::cerr << "  parse [iterations]             string parser vs w1::parse" << std::endl;
+    std::cerr << "  fuzz-parse [iterations] [seed] random inputs into w1::parse" << std::endl;
+    std::cerr << "  sweep [max sensors] [cycles] [bits] [parasite]" << std::endl;
+    std::cerr << "                                 serial vs parallel vs bulk read, simulated bus" << std::endl;
+    std::cerr << "  idle [seconds]                 CPU time and wakeups, busy polling vs epoll" << std::endl;
+    std::cerr << "  gpio [chip] [line] [count]     print edge events with kernel timestamps" << std::endl;
+    std::cerr << "  jitter [period ms] [cycles] [work ms]" << std::endl;
+    std::cerr << "                                 sample start times, relative sleep vs absolute deadlines" << std::endl;
+    std::cerr << "  clock [samples]                scheduler and pipeline timing checks on a fake clock" << std::endl;
+    std::cerr << "  stress [seconds] [priority] [cpu] [period ms]" << std::endl;
+    std::cerr << "                                 sample latency under load, real-time profile off vs on" << std::endl;
+    std::cerr << "  display [iterations]           SSD1306 flush cost per frame, old buffered writes vs one ioctl" << std::endl;
+    std::cerr << "  render [dir]                   display frames through the SSD1306 emulator, saved as PBM" << std::endl;
+    return 1;
+}
@@ -1,45 +1,53 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <httplib.h>
 #include <json.hpp>
 #include <unistd.h>
+#include <sys/resource.h>
+#include "gpiochip.hpp"
+#include "pipeline.hpp"
+#include "reactor.hpp"
+#include "realtime.hpp"
 #include "rpi1306i2c.hpp"
-#include <sstream>
-#include <iomanip>
-#include <wiringPi.h>
+#include "samples.hpp"
+#include "scheduler.hpp"
+#include "timing.hpp"
+#include "w1therm.hpp"
 
 using json = nlohmann::json;
 
 const int BUTTON_SENSOR1 = 27;
 const int BUTTON_SENSOR2 = 22;
 
-// Need volatile variables to support interrupts
-volatile bool sensor1Enabled = false;
-volatile bool sensor2Enabled = false;
+// Switch to turn the whole system on and off - low is off
+const int POWER_SWITCH = 23;
 
-const unsigned int DEBOUNCE_DELAY = 100;
-volatile unsigned int lastPressTime1 = 0;
-volatile unsigned int lastPressTime2 = 0;
+// Sensors are indexed like the discovery table, the first two slots have a pushbutton
+const size_t MAX_SENSORS = 32;
 
-// Change the sensor variable
-void buttonCallback(int buttonPin, volatile unsigned int& lastPressTime, volatile bool& sensorEnabled) {
-    unsigned int currentTime = millis();
-    if (currentTime - lastPressTime > DEBOUNCE_DELAY) {
-        sensorEnabled = !sensorEnabled;
-        std::cout << "Sensor " << (buttonPin == BUTTON_SENSOR1 ? "1" : "2") << " toggled to " << (sensorEnabled ? "ON" : "OFF") << std::endl;
-        lastPressTime = currentTime;
-    }
-}
+// Written by the main thread (buttons, server), read by the sampling and display stages
+std::atomic<bool> sensorEnabled[MAX_SENSORS];
 
-// ISR for button 1
-void button1Interrupt() {
-    buttonCallback(BUTTON_SENSOR1, lastPressTime1, sensor1Enabled);
-}
+// Applied by the kernel on the button lines, edges closer together than this are dropped
+const std::chrono::microseconds DEBOUNCE_PERIOD(100000);
 
-// ISR for button 2
-void button2Interrupt() {
-    buttonCallback(BUTTON_SENSOR2, lastPressTime2, sensor2Enabled);
+// Change the sensor variable
+void toggleSensor(size_t sensor) {
+    bool enabled = !sensorEnabled[sensor].load();
+    sensorEnabled[sensor].store(enabled);
+    std::cout << "Sensor " << sensor + 1 << " toggled to " << (enabled ? "ON" : "OFF") << std::endl;
 }
 
 // Simple helper to change the unit of measurement
@@ -51,221 +59,985 @@ std::string changeUnits(std::string unit) {
     }
 }
 
-// Reads the temperature from the given device
-double readTemperature(const std::string &devicePath) {
-    std::ifstream file(devicePath + "/w1_slave");
-    std::string line1, line2;
+// Sample history, preallocated so sampling never allocates
+// It is also the queue between the pipeline stages: the sampling thread pushes, display and upload each read
+const size_t HISTORY_SIZE = 4096;
+samples::Ring<HISTORY_SIZE> history;
+using SampleStage = pipeline::Stage<HISTORY_SIZE>;
+
+// Milliseconds with a fractional part, for the timing log
+double toMillis(timing::Monotonic::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// The 128x32 panel fits four 8 pixel text rows, one per sensor
+using Panel = ssd1306::Display128x32;
+const size_t DISPLAY_ROWS = 4;
+static_assert(DISPLAY_ROWS <= Panel::height() / 8, "One text row per sensor");
+
+// Static parts of the sensor lines, rasterized at compile time
+constexpr ssd1306::Label<10> SENSOR_LABELS[DISPLAY_ROWS] = {
+    ssd1306::label("Sensor 1: "), ssd1306::label("Sensor 2: "), ssd1306::label("Sensor 3: "), ssd1306::label("Sensor 4: "),
+};
+constexpr auto OFF_LABEL = ssd1306::label("OFF");
+constexpr auto UNPLUGGED_LABEL = ssd1306::label("Unplugged");
+constexpr auto CELSIUS_LABEL = ssd1306::label(" C");
+constexpr auto FAHRENHEIT_LABEL = ssd1306::label(" F");
+
+// Trend graph at the right end of each reading's row, clear of the longest reading ("Sensor 1: 100.00 F")
+const uint8_t TREND_X = 110;
+const uint8_t TREND_WIDTH = 18;
+
+// Tries per I2C transfer, 1 ms before the first retry and doubling: a transfer is given up on after 7 ms
+const uint8_t DISPLAY_ATTEMPTS = 4;
+const std::chrono::milliseconds DISPLAY_BACKOFF(1);
+
+// The display stage: keeps the last sample of every row and redraws the rows whose text changed
+// It owns the panel and is the only thread that touches the I2C bus, so a slow or stuck bus never delays sampling
+// or the controls. The setters only store the latest state and wake it; redraws are capped at maxRate per second
+// (0: no cap) and whatever changes in between is coalesced into the next one
+// Next to each reading, a sparkline of the last trendMinutes (0: none), one column per bucket of samples
+// I2C errors are retried and, if the bus keeps refusing, the frame is dropped and the panel reinitialized on the
+// next redraw. That holds from the init sequence on, and a missing adapter or panel is opened on a later redraw:
+// the display never throws, neither at startup nor out of the stage
+class Dashboard {
+public:
+    Dashboard(uint8_t i2cBus, uint8_t address, unsigned int maxRate, unsigned int trendMinutes)
+        : m_screen(ssd1306::OnError::Recover, i2cBus, address, i2c::Open::Retry),
+          m_text(m_screen),
+          m_trends{{m_screen, TREND_X, 0, TREND_WIDTH, 8}, {m_screen, TREND_X, 8, TREND_WIDTH, 8},
+                   {m_screen, TREND_X, 16, TREND_WIDTH, 8}, {m_screen, TREND_X, 24, TREND_WIDTH, 8}},
+          m_bucketNs(uint64_t(trendMinutes) * 60 * 1000000000 / TREND_WIDTH),
+          m_stage(history, [this](const samples::Sample &sample) { collect(sample); }, [this] { render(); }) {
+        m_screen.setErrorHandling(ssd1306::OnError::Recover, DISPLAY_ATTEMPTS, DISPLAY_BACKOFF);
+        // Blank frame before anything can wake the stage
+        m_screen.clear();
+        m_screen.flush();
+        checkBus();
+        for (ssd1306::Sparkline<Panel> &trend : m_trends) {
+            trend.hide();
+        }
+        setMaxRate(maxRate);
+    }
+
+    void setMaxRate(unsigned int maxRate) {
+        m_stage.setMinInterval(maxRate > 0 ? std::chrono::nanoseconds(std::chrono::seconds(1)) / maxRate
+                                           : std::chrono::nanoseconds(0));
+    }
+
+    // Thread-safe, never blocks on the bus
+    void notify() {
+        m_stage.notify();
+    }
+
+    void setUnit(const std::string &unit) {
+        m_unit.store(unit == "F" ? 'F' : 'C');
+        m_stage.notify();
+    }
+
+    void setActive(bool active) {
+        m_active.store(active);
+        m_stage.notify();
+    }
+
+    void setSensorCount(size_t count) {
+        m_sensors.store(count);
+        m_stage.notify();
+    }
+
+    const SampleStage &stage() const {
+        return m_stage;
+    }
+
+    // Thread-safe
+    ssd1306::BusErrors busErrors() const {
+        return m_screen.errors();
+    }
+
+private:
+    Panel m_screen;
+    ssd1306::TextLayer<Panel> m_text;
+    ssd1306::Sparkline<Panel> m_trends[DISPLAY_ROWS];
+    const uint64_t m_bucketNs;
+    std::atomic<char> m_unit{'C'};
+    std::atomic<bool> m_active{false};
+    std::atomic<size_t> m_sensors{0};
+
+    // Display thread only
+    samples::Status m_status[DISPLAY_ROWS] = {};
+    double m_temperature[DISPLAY_ROWS] = {};
+    uint64_t m_bucketEnd[DISPLAY_ROWS] = {};
+    double m_bucketSum[DISPLAY_ROWS] = {};
+    unsigned int m_bucketCount[DISPLAY_ROWS] = {};
+    bool m_blank = true;
+    bool m_shown = false;
+    bool m_lost = false;
+
+    // Last, its thread uses the members above
+    SampleStage m_stage;
+
+    void collect(const samples::Sample &sample) {
+        if (sample.sensor >= DISPLAY_ROWS) {
+            return;
+        }
+        m_status[sample.sensor] = sample.status;
+        if (sample.status == samples::Status::Ok) {
+            m_temperature[sample.sensor] = sample.milliCelsius / 1000.0;
+            addToTrend(sample.sensor, sample.monotonicNs, m_temperature[sample.sensor]);
+        }
+    }
+
+    // The newest column is the running mean of its bucket; a sample past the bucket's end starts the next column
+    // The graph stays in Celsius, its shape is the same in either unit
+    void addToTrend(size_t row, uint64_t monotonicNs, double celsius) {
+        if (m_bucketNs == 0) {
+            return;
+        }
+        if (m_bucketCount[row] == 0 || monotonicNs >= m_bucketEnd[row]) {
+            m_bucketEnd[row] = monotonicNs + m_bucketNs;
+            m_bucketSum[row] = celsius;
+            m_bucketCount[row] = 1;
+            m_trends[row].push(celsius);
+        } else {
+            m_bucketSum[row] += celsius;
+            m_bucketCount[row]++;
+            m_trends[row].update(m_bucketSum[row] / m_bucketCount[row]);
+        }
+    }
+
+    // Reports when the panel stops taking frames and when it is back
+    void checkBus() {
+        if (m_screen.lost() == m_lost) {
+            return;
+        }
+        m_lost = m_screen.lost();
+        if (m_lost) {
+            std::cerr << "Display write failed: " << std::strerror(-m_screen.errors().lastError)
+                      << ", reinitializing it on the next redraw" << std::endl;
+        } else {
+            std::cout << "Display back (" << m_screen.errors().reinits << " reinits so far)" << std::endl;
+        }
+    }
+
+    void render() {
+        // Blank the screen once while the system is off
+        if (!m_active.load()) {
+            if (!m_blank) {
+                for (ssd1306::Sparkline<Panel> &trend : m_trends) {
+                    trend.hide();
+                }
+                m_text.clear();
+                m_screen.flush();
+                checkBus();
+                m_blank = true;
+            }
+            return;
+        }
+        m_blank = false;
+
+        char unit = m_unit.load();
+        size_t rows = std::min(m_sensors.load(), DISPLAY_ROWS);
+        for (size_t i = 0; i < rows; i++) {
+            // Labels are copied whole, only the digits go through the font
+            // The trend shares the row with the text: it is cleared before a long status and drawn after a reading
+            uint8_t column = m_text.put(i, 0, SENSOR_LABELS[i]);
+            bool reading = sensorEnabled[i] && m_status[i] != samples::Status::Unplugged &&
+                           m_status[i] != samples::Status::Invalid;
+            if (!reading) {
+                m_trends[i].hide();
+            }
+            if (!sensorEnabled[i]) {
+                column = m_text.put(i, column, OFF_LABEL);
+            } else if (!reading) {
+                // If the sensor is supposed to be on, but no valid reading is found, the sensor has been unplugged
+                column = m_text.put(i, column, UNPLUGGED_LABEL);
+            } else {
+                // Potential conversion to Fahrenheit, the samples stay in Celsius
+                double displayTemperature = m_temperature[i];
+                if (unit == 'F') {
+                    displayTemperature = displayTemperature * 9 / 5.0 + 32;
+                }
+                char digits[16];
+                std::snprintf(digits, sizeof(digits), "%.2f", displayTemperature);
+                column = m_text.put(i, column, digits);
+                column = m_text.put(i, column, unit == 'F' ? FAHRENHEIT_LABEL : CELSIUS_LABEL);
+            }
+            m_text.end(i, column);
+            if (reading && m_bucketNs > 0) {
+                m_trends[i].show();
+            }
+        }
+        // Rows of sensors that went away
+        for (size_t i = rows; i < DISPLAY_ROWS; i++) {
+            m_trends[i].hide();
+            m_text.print(i, "");
+        }
+        // Only the columns that changed go over I2C
+        m_screen.flush();
+        checkBus();
+        if (!m_shown && rows > 0) {
+            m_shown = true;
+            std::cout << "First readings on screen " << toMillis(timing::sinceProcessStart()) << " ms after process start"
+                      << std::endl;
+        }
+    }
+};
+
+// Optional settings file, e.g. {"resolution": 10, "readInterval": 200, "sensors": {"28-000010eb7a80": {"resolution": 9}},
+//                                "displayRate": 10, "trendMinutes": 10, "realtime": {"priority": 80, "cpu": 3}}
+const char *CONFIG_PATH = "thermostat.json";
+
+struct Config {
+    // DS18B20 resolution in bits for every probe, unless overridden by its w1 id; 0 leaves the probes as they are
+    int resolution = 0;
+    std::map<std::string, int> sensorResolution;
+    // Sampling period in ms, stretched if the slowest conversion does not fit
+    unsigned int readInterval = 1000;
+    // Off unless configured; needs root (or CAP_SYS_NICE and CAP_IPC_LOCK)
+    rt::Profile realtime;
+    // Display redraws per second at most, 0 for no cap
+    unsigned int displayRate = 10;
+    // Span of the trend graph next to each reading, 0 for none
+    unsigned int trendMinutes = 10;
+};
+
+// Reads the settings file, a missing or malformed file leaves the defaults
+Config loadConfig(const std::string &path) {
+    Config config;
+    std::ifstream file(path);
+    if (!file) {
+        return config;
+    }
+    json j = json::parse(file, nullptr, false);
+    if (j.is_discarded() || !j.is_object()) {
+        std::cerr << "Ignoring malformed config " << path << std::endl;
+        return config;
+    }
+    if (j.contains("resolution") && j["resolution"].is_number_integer()) {
+        config.resolution = j["resolution"].get<int>();
+    }
+    if (j.contains("readInterval") && j["readInterval"].is_number_unsigned()) {
+        config.readInterval = j["readInterval"].get<unsigned int>();
+    }
+    if (j.contains("displayRate") && j["displayRate"].is_number_unsigned()) {
+        config.displayRate = j["displayRate"].get<unsigned int>();
+    }
+    if (j.contains("trendMinutes") && j["trendMinutes"].is_number_unsigned()) {
+        config.trendMinutes = j["trendMinutes"].get<unsigned int>();
+    }
+    if (j.contains("realtime") && j["realtime"].is_object()) {
+        const json &realtime = j["realtime"];
+        if (realtime.contains("priority") && realtime["priority"].is_number_integer()) {
+            config.realtime.priority = std::clamp(realtime["priority"].get<int>(), 0, 99);
+        }
+        if (realtime.contains("cpu") && realtime["cpu"].is_number_integer()) {
+            config.realtime.cpu = realtime["cpu"].get<int>();
+        }
+    }
+    if (j.contains("sensors") && j["sensors"].is_object()) {
+        for (auto &[id, settings] : j["sensors"].items()) {
+            if (settings.is_object() && settings.contains("resolution") && settings["resolution"].is_number_integer()) {
+                config.sensorResolution[id] = settings["resolution"].get<int>();
+            }
+        }
+    }
+    return config;
+}
+
+// Resolution configured for a probe, by its w1 id, or 0 when nothing is configured
+int configuredResolution(const Config &config, const std::string &id) {
+    auto configured = config.sensorResolution.find(id);
+    return configured != config.sensorResolution.end() ? configured->second : config.resolution;
+}
+
+// Extra time on top of the datasheet conversion time before a probe counts as missing
+// It only sizes the read deadline, the sampling period is not padded by it
+const std::chrono::milliseconds CONVERSION_MARGIN(150);
+
+// What a cycle takes beyond the slowest conversion (bus transactions, scratchpad reads, worker wakeups) until
+// the cycle log has measured it; one match ROM and 9 byte scratchpad read is about 12 ms
+const std::chrono::milliseconds READ_OVERHEAD_ESTIMATE(20);
+
+// Good cycles the measured overhead is the largest of: about a minute at 5 Hz, so one slow cycle lowers the
+// sampling rate for a while instead of for good
+const size_t OVERHEAD_WINDOW = 256;
+
+// Applies a probe's resolution, 0 keeps the one it has, and sizes its conversion deadline to match
+// Returns the resolution the probe actually runs at
+int applyResolution(w1::Acquisition &acquisition, const w1::Discovery &discovery, size_t sensor, int bits) {
+    std::string devicePath = discovery.devicePath(sensor);
+    int err = bits != 0 ? w1::writeResolution(devicePath, bits) : 0;
+    if (err < 0) {
+        std::cerr << "Could not set sensor " << sensor + 1 << " to " << bits << " bits: " << std::strerror(-err) << std::endl;
+    }
+
+    // Trust the probe over the request, and budget for 12 bits if it cannot be read back
+    int actual = w1::readResolution(devicePath);
+    if (actual < 0) {
+        actual = w1::MAX_RESOLUTION;
+    }
+    acquisition.setTimeout(sensor, w1::conversionTime(actual) + CONVERSION_MARGIN);
+    return actual;
+}
+
+// Puts a sensor under its bus master's therm_bulk_read so the whole bus converts at once
+// masters maps each master directory to its acquisition index, or -1 when the kernel has no bulk read
+void attachBulkRead(w1::Acquisition &acquisition, const w1::Discovery &discovery, size_t sensor,
+                    std::map<std::string, int> &masters) {
+    std::string masterPath = discovery.masterPath(sensor);
+    if (masterPath.empty()) {
+        return;
+    }
+    auto known = masters.find(masterPath);
+    if (known == masters.end()) {
+        w1::Sensor bulkRead(masterPath, "therm_bulk_read", O_RDWR);
+        int index = -1;
+        if (bulkRead.isOpen()) {
+            index = acquisition.addMaster(std::move(bulkRead));
+            std::cout << "Bulk conversion enabled on " << masterPath << std::endl;
+        }
+        known = masters.emplace(masterPath, index).first;
+    }
+    if (known->second >= 0) {
+        acquisition.setMaster(sensor, known->second);
+    }
+}
+
+// Sampling period that fits the slowest probe's conversion and the read overhead, rounded up to 10 ms so that
+// the overhead measured from cycle to cycle does not keep moving the grid. 9 bits: 93.75 ms + overhead, 5-10 Hz
+unsigned int readIntervalFor(const Config &config, const std::vector<int> &resolutions,
+                             std::chrono::microseconds overhead) {
+    std::chrono::microseconds slowest(0);
+    for (int bits : resolutions) {
+        slowest = std::max(slowest, w1::conversionTime(bits));
+    }
+    auto budget = std::chrono::ceil<std::chrono::milliseconds>(slowest + overhead);
+    unsigned int floor = (budget.count() + 9) / 10 * 10;
+    return std::max<unsigned int>(config.readInterval, floor);
+}
+
+// One sampling cycle's timings, copied out of the sampling thread for the log
+struct CycleLog {
+    timing::Monotonic::duration cycle{};
+    timing::Monotonic::duration bulk{};
+    size_t sensors = 0;
+    w1::ReadStatus status[MAX_SENSORS] = {};
+    timing::Monotonic::duration elapsed[MAX_SENSORS] = {};
+};
+
+// Probe settings the server appended to its answer: {"resolution": 9 or [9, 12, ...], "readInterval": 200}
+// Parsed on the main thread so the sampling thread never touches JSON
+struct Settings {
+    unsigned int readInterval = 0;      // 0 keeps the current one
+    std::vector<int> resolution;        // per sensor, 0 keeps a probe's current resolution
+    int allResolution = 0;              // for sensors past the end of resolution
+};
+
+Settings parseSettings(const json &settings) {
+    Settings parsed;
+    if (settings.contains("readInterval") && settings["readInterval"].is_number_unsigned()) {
+        parsed.readInterval = settings["readInterval"].get<unsigned int>();
+    }
+    if (settings.contains("resolution")) {
+        const json &requested = settings["resolution"];
+        if (requested.is_array()) {
+            for (const json &value : requested) {
+                parsed.resolution.push_back(value.is_number_integer() ? value.get<int>() : 0);
+            }
+        } else if (requested.is_number_integer()) {
+            parsed.allResolution = requested.get<int>();
+        }
+    }
+    return parsed;
+}
+
+// The upload stage: posts the samples to the server on its own thread so sampling never waits on the network
+// Samples that arrive while a POST is in flight go into the next payload, newest reading per sensor
+class Uploader {
+public:
+    struct Response {
+        bool ok = false;
+        int status = 0;
+        std::string body;
+        std::string error;
+    };
 
-    // Error checking the read
-    if (!std::getline(file, line1) || !std::getline(file, line2)) {
-        throw std::runtime_error("Failed to read sensor file");
+    Uploader(const std::string &host, event::Notifier &done)
+        : m_client(host), m_done(done),
+          m_stage(history, [this](const samples::Sample &sample) { collect(sample); }, [this] { post(); }) {}
+
+    // Thread-safe, posts whatever was sampled since the last upload, which may be nothing
+    void notify() {
+        m_stage.notify();
     }
 
-    // CRC check
-    if (line1.find("YES") == std::string::npos) {
-        throw std::runtime_error("CRC check failed");
+    // Takes the latest server response, returns false if none arrived since the last call
+    bool takeResponse(Response &response) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_hasResponse) {
+            return false;
+        }
+        response = std::move(m_response);
+        m_hasResponse = false;
+        return true;
     }
 
-    // Check that the temperature exists
-    size_t tEqualsPosition = line2.find("t=");
-    if (tEqualsPosition == std::string::npos) {
-        throw std::runtime_error("Temperature not found");
+    const SampleStage &stage() const {
+        return m_stage;
     }
 
-    int milliCelsius = std::stoi(line2.substr(tEqualsPosition + 2));
-    // Convert to degrees Celsius
-    return milliCelsius / 1000.0;  
+private:
+    httplib::Client m_client;
+    event::Notifier &m_done;
+    json m_payload;     // upload thread only
+    std::mutex m_mutex;
+    Response m_response;
+    bool m_hasResponse = false;
+
+    // Last, its thread uses the members above
+    SampleStage m_stage;
+
+    // ALWAYS SEND TEMPERATURE IN CELSIUS- THE SERVER WILL HANDLE CONVERSIONS
+    void collect(const samples::Sample &sample) {
+        std::string key = "sensor" + std::to_string(sample.sensor + 1) + "Temperature";
+        if (sample.status == samples::Status::Ok) {
+            m_payload[key] = sample.milliCelsius / 1000.0;
+        } else {
+            m_payload[key] = nullptr;
+        }
+    }
+
+    // A pass with no samples (no probes plugged in) still posts an empty object: the answer to it is how the
+    // server's settings reach us, so the control channel stays up as long as cycles run
+    void post() {
+        if (m_payload.is_null()) {
+            m_payload = json::object();
+        }
+        std::string payload = m_payload.dump();
+        m_payload = json();
+
+        Response response;
+        auto res = m_client.Post("/temperatureData", payload, "application/json");
+        if (res) {
+            response.ok = true;
+            response.status = res->status;
+            response.body = res->body;
+        } else {
+            response.error = httplib::to_string(res.error());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_response = std::move(response);
+            m_hasResponse = true;
+        }
+        m_done.notify();
+    }
+};
+
+// CPU time used by the whole process so far
+double cpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// CPU time and wakeups of every thread's loop, scaled to one hour, for comparing power use
+// offWakeups counts the wakeups that happened while the power switch was off, switching off included
+void printPowerStats(uint64_t wakeups, timing::Monotonic::time_point start, uint64_t offWakeups) {
+    double hours = std::chrono::duration<double>(timing::Monotonic::now() - start).count() / 3600.0;
+    double cpu = cpuSeconds();
+    std::cout << "Uptime " << hours * 3600.0 << " s, CPU " << cpu << " s (" << cpu / hours << " s/hour), "
+              << wakeups << " wakeups (" << wakeups / hours << " /hour), "
+              << offWakeups << " while off" << std::endl;
 }
 
-int main() {
-    // Listen on local port 8050
-    httplib::Client client("http://localhost:8050");
+// Queue depth and latency of a consumer stage
+void printStageStats(const std::string &name, const SampleStage &stage) {
+    std::cout << "Stage " << name << ": depth " << stage.depth() << ", " << stage.processed() << " samples, "
+              << stage.dropped() << " dropped, latency " << toMillis(stage.latency().mean()) << " ms mean / "
+              << toMillis(stage.latency().max()) << " ms max, pass " << toMillis(stage.service().mean()) << " ms mean / "
+              << toMillis(stage.service().max()) << " ms max, " << stage.held() << " held by the rate cap" << std::endl;
+}
 
-    // Screen initialization
-    ssd1306::Display128x32 screen(1, 0x3C);
-    screen.clear();
+int main(int argc, char **argv) {
+    // --measure SECONDS prints CPU time and wakeups per hour after that long, then exits
+    std::string configPath = CONFIG_PATH;
+    int measureSeconds = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--measure" && i + 1 < argc) {
+            measureSeconds = std::atoi(argv[++i]);
+        } else {
+            configPath = arg;
+        }
+    }
+    Config config = loadConfig(configPath);
 
-    if (wiringPiSetupGpio() == -1) {
-        std::cerr << "WiringPi initialization failed." << std::endl;
-        return 1;
+    // Real-time profile for the sampling path: memory locked before the threads start,
+    // each sampling thread moves itself to SCHED_FIFO on its core when it starts
+    const rt::Profile realtime = config.realtime;
+    if (realtime.enabled()) {
+        int err = rt::lockMemory();
+        if (err < 0) {
+            std::cerr << "Could not lock memory: " << std::strerror(-err) << std::endl;
+        }
     }
 
-    // Set GPIO pin to input
-    pinMode(BUTTON_SENSOR1, INPUT);
-    pullUpDnControl(BUTTON_SENSOR1, PUD_UP);
+    // Taken over before any thread starts so every thread inherits the blocked mask
+    // SIGINT/SIGTERM stop cleanly, SIGUSR1 prints the power and pipeline statistics
+    event::Signals signals({SIGINT, SIGTERM, SIGUSR1});
+    event::Loop loop;
+    auto startTime = timing::Monotonic::now();
+
+    // Screen initialization: one command stream, then a blank frame
+    Dashboard dashboard(1, 0x3C, config.displayRate, config.trendMinutes);
+    std::cout << (dashboard.busErrors().dropped > 0 ? "Display not answering after " : "Display ready in ")
+              << toMillis(timing::Monotonic::now() - startTime) << " ms, " << toMillis(timing::sinceProcessStart())
+              << " ms after process start" << std::endl;
 
-    // Configure falling edge interrupt for pushbutton 1
-    if (wiringPiISR(BUTTON_SENSOR1, INT_EDGE_FALLING, &button1Interrupt) < 0) {
-        std::cerr << "Unable to set up ISR for BUTTON 1." << std::endl;
-        return 1;
+    // Three stages connected by the history ring: sampling (its own loop and thread, below) pushes,
+    // the display and upload stages each drain it on their own thread. Neither ever holds up sampling,
+    // a stage that falls a whole ring behind loses its oldest samples
+    // Server responses arrive on the upload thread and wake the main loop, which handles the controls
+    event::Notifier uploadEvents;
+    Uploader uploader("http://localhost:8050", uploadEvents);
+
+    // Falling edges on the pushbuttons (pulled up, pressed pulls low), queued by the kernel with their timestamp
+    gpio::Lines buttons(gpio::DEFAULT_CHIP, {BUTTON_SENSOR1, BUTTON_SENSOR2}, gpio::Edge::Falling,
+                        gpio::Bias::PullUp, DEBOUNCE_PERIOD);
+
+    // Both edges on the power switch (pulled down, on pulls high); while it is off the loops have nothing to wake them
+    gpio::Lines powerSwitch(gpio::DEFAULT_CHIP, {POWER_SWITCH}, gpio::Edge::Both, gpio::Bias::PullDown, DEBOUNCE_PERIOD);
+    std::atomic<bool> systemActive(powerSwitch.value(POWER_SWITCH) == 1);
+
+    // Find every temperature probe on every bus master; the table is refreshed when the kernel reports a change
+    w1::Discovery discovery;
+    discovery.refresh(true);
+
+    // Open the sensor attributes once, they are re-read in place every cycle
+    // All probes convert at the same time, each one's deadline follows its resolution
+    const std::chrono::milliseconds CONVERSION_TIMEOUT(900);
+    std::vector<w1::Sensor> sensors;
+    for (size_t i = 0; i < discovery.size() && i < MAX_SENSORS; i++) {
+        sensors.emplace_back(discovery.devicePath(i));
+        std::cout << "Found sensor " << i + 1 << ": " << discovery.sensors()[i].id << std::endl;
+    }
+    // The conversion workers share the sampling thread's profile; a failure shows on the sampling thread
+    std::function<void()> workerSetup;
+    if (realtime.enabled()) {
+        workerSetup = [realtime] { rt::enter(realtime); };
     }
+    size_t sensorCount = sensors.size();
+    w1::Acquisition acquisition(std::move(sensors), CONVERSION_TIMEOUT, workerSetup);
+    acquisition.reserve(MAX_SENSORS, MAX_SENSORS);
 
-    // Set GPIO pin to input
-    pinMode(BUTTON_SENSOR2, INPUT);
-    pullUpDnControl(BUTTON_SENSOR2, PUD_UP);
+    // Lower resolutions convert much faster (94 ms at 9 bits against 750 ms at 12 bits)
+    // requestedResolutions holds the last bits asked for per probe, so a probe that refuses a write is not
+    // written again on every server response asking for the same thing
+    std::vector<int> resolutions;
+    std::vector<int> requestedResolutions;
+    for (size_t i = 0; i < sensorCount; i++) {
+        int bits = configuredResolution(config, discovery.sensors()[i].id);
+        requestedResolutions.push_back(bits);
+        resolutions.push_back(applyResolution(acquisition, discovery, i, bits));
+    }
 
-    // Configure falling edge interrupt for pushbutton 2
-    if (wiringPiISR(BUTTON_SENSOR2, INT_EDGE_FALLING, &button2Interrupt) < 0) {
-        std::cerr << "Unable to set up ISR for BUTTON 2." << std::endl;
-        return 1;
+    // Fall back to one conversion per w1_slave read on buses without therm_bulk_read
+    std::map<std::string, int> bulkMasters;
+    for (size_t i = 0; i < sensorCount; i++) {
+        attachBulkRead(acquisition, discovery, i, bulkMasters);
     }
+    dashboard.setSensorCount(sensorCount);
 
-    unsigned int lastReadTime = 0;
-    const unsigned int READ_INTERVAL = 1000;
-    bool lastSensor1Enabled = false;
-    bool lastSensor2Enabled = false;
+    // The sampling thread (SCHED_FIFO with a real-time profile) only runs the cycles: acquire(), the history
+    // pushes and its deadline grid. Everything that can block or allocate stays on the main thread: discovery,
+    // starting the workers of new probes, resolution writes, server settings and the log. The main thread
+    // hands it a new period through samplerInterval and wakes it with samplerControl; the sampling thread
+    // leaves each cycle's timings in lastCycle for the log and wakes the main thread with samplerEvents
+    event::Loop sampler;
+    event::Notifier samplerControl;
+    event::Notifier samplerStop;
+    event::Notifier samplerEvents;
+    pipeline::Latency cycleTime;
+    std::mutex lastCycleMutex;
+    CycleLog lastCycle;
+
+    // Samples are due on a fixed grid of absolute deadlines, the sample timer is a one-shot set to the next one
+    // and disarmed while the system is off. jitter is how late each cycle actually started
+    event::Timer sampleTimer;
+    bool timerArmed = false;
+    std::chrono::microseconds readOverhead = READ_OVERHEAD_ESTIMATE;
+    std::array<std::chrono::microseconds, OVERHEAD_WINDOW> overheads{};
+    size_t overheadCount = 0;
+    unsigned int readInterval = readIntervalFor(config, resolutions, readOverhead);
+    std::atomic<unsigned int> samplerInterval{readInterval};
+    unsigned int samplerPeriod = readInterval;
+    scheduler::Deadlines deadlines{std::chrono::milliseconds(readInterval)};
+    scheduler::Histogram jitter;
+    std::vector<bool> sensorsEnabled(MAX_SENSORS, false);
+    std::cout << "Sampling every " << readInterval << " ms" << std::endl;
 
     // Keeping track of the units to display
     std::string unit = "C";
 
-    // Display "OFF" with added spaces to clear any leftover characters
-    // Sensors are assumed to start off
-    screen.drawString(0, 0, "Sensor 1: OFF     ");
-    screen.drawString(0, 8, "Sensor 2: OFF     ");
-
-    while (true) {
-        double temperature1 = 0.0;
-        double temperature2 = 0.0;
-        bool temperature1Null;
-        bool temperature2Null;
+    // Main thread: recomputes the period when the slowest conversion, the overhead or the configured interval
+    // changed; the sampling thread picks it up between two cycles
+    auto updateInterval = [&]() {
+        unsigned int interval = readIntervalFor(config, resolutions, readOverhead);
+        if (interval != readInterval) {
+            readInterval = interval;
+            samplerInterval.store(readInterval);
+            samplerControl.notify();
+            std::cout << "Sampling every " << readInterval << " ms" << std::endl;
+        }
+    };
 
-        // Get the current time (used to only read once per second)
-        unsigned int currentTime = millis();
+    // Main thread: picks up probes that were plugged in since the last scan; their workers start here and
+    // join the cycles from the next one
+    auto refreshSensors = [&](bool force) {
+        if (discovery.refresh(force) == 0) {
+            return;
+        }
+        for (size_t i = sensorCount; i < discovery.size() && i < MAX_SENSORS; i++) {
+            acquisition.add(w1::Sensor(discovery.devicePath(i)), CONVERSION_TIMEOUT);
+            std::cout << "Found sensor " << i + 1 << ": " << discovery.sensors()[i].id << std::endl;
+            int bits = configuredResolution(config, discovery.sensors()[i].id);
+            requestedResolutions.push_back(bits);
+            resolutions.push_back(applyResolution(acquisition, discovery, i, bits));
+            attachBulkRead(acquisition, discovery, i, bulkMasters);
+            sensorCount++;
+        }
+        dashboard.setSensorCount(sensorCount);
+        updateInterval();
+    };
 
-        // In case this has been changed from the interrupt (tough to implement at the interrupt level)
-        if (lastSensor1Enabled != sensor1Enabled) {
-            if (!sensor1Enabled) {
-                screen.drawString(0, 0, "Sensor 1: OFF       ");
-            } else {
-                std::ostringstream ss1;
-                ss1 << "Sensor 1: " << std::fixed << std::setprecision(2) << temperature1 << " C    ";
-                screen.drawString(0, 0, ss1.str());
+    // Main thread: a cycle in which every enabled probe answered shows how long reading takes beyond the
+    // slowest conversion. The estimate is the largest overhead of the last OVERHEAD_WINDOW such cycles
+    auto measureOverhead = [&](const CycleLog &cycle) {
+        std::chrono::microseconds slowest(0);
+        for (size_t i = 0; i < cycle.sensors; i++) {
+            if (cycle.status[i] == w1::ReadStatus::Skipped) {
+                continue;
             }
-            lastSensor1Enabled = sensor1Enabled;
+            if (cycle.status[i] != w1::ReadStatus::Ok) {
+                return;
+            }
+            slowest = std::max(slowest, w1::conversionTime(resolutions[i]));
+        }
+        if (slowest.count() == 0) {
+            return;
         }
+        auto overhead = std::max(std::chrono::duration_cast<std::chrono::microseconds>(cycle.cycle) - slowest,
+                                 std::chrono::microseconds(0));
+        overheads[overheadCount++ % OVERHEAD_WINDOW] = overhead;
+        size_t window = std::min(overheadCount, OVERHEAD_WINDOW);
+        readOverhead = *std::max_element(overheads.begin(), overheads.begin() + window);
+        updateInterval();
+    };
 
-        if (lastSensor2Enabled != sensor2Enabled) {
-            if (!sensor2Enabled) {
-                screen.drawString(0, 8, "Sensor 2: OFF        "); 
-            } else {
-                std::ostringstream ss2;
-                ss2 << "Sensor 2: " << std::fixed << std::setprecision(2) << temperature1 << " C    ";
-                screen.drawString(0, 8, ss2.str());
+    // Main thread: settings from the server
+    auto applySettings = [&](const Settings &settings) {
+        if (settings.readInterval > 0) {
+            config.readInterval = settings.readInterval;
+        }
+        for (size_t i = 0; i < sensorCount; i++) {
+            int bits = i < settings.resolution.size() ? settings.resolution[i] : settings.allResolution;
+            if (bits == 0 || bits == requestedResolutions[i]) {
+                continue;
+            }
+            requestedResolutions[i] = bits;
+            if (bits != resolutions[i]) {
+                resolutions[i] = applyResolution(acquisition, discovery, i, bits);
             }
-            lastSensor2Enabled = sensor2Enabled;
         }
+        updateInterval();
+    };
+
+    // One sampling cycle: read every probe, push the samples and wake the display and upload stages
+    // Samples are stamped with the cycle start, when every conversion was started, and published once all of
+    // them are read, which is where the stage latencies start
+    auto sampleSensors = [&](timing::Monotonic::time_point start) {
+        // Start every enabled sensor's conversion at once and wait for all of them
+        for (size_t i = 0; i < MAX_SENSORS; i++) {
+            sensorsEnabled[i] = sensorEnabled[i];
+        }
+        acquisition.acquire(sensorsEnabled);
+        cycleTime.record(acquisition.lastCycle());
+
+        uint64_t sampleTime = timing::toNanos(start);
+        uint64_t publishTime = timing::nowNanos();
+
+        for (size_t i = 0; i < acquisition.size(); i++) {
+            samples::Sample sample;
+            sample.monotonicNs = sampleTime;
+            sample.publishedNs = publishTime;
+            sample.sensor = i;
 
-        // If one second has elapsed
-        if (currentTime - lastReadTime >= READ_INTERVAL) {
             // If the sensor is on, get a reading
-            if (sensor1Enabled) {
-                try {
-                    temperature1 = readTemperature("/sys/bus/w1/devices/28-000010eb7a80");
-
-                    // Set upper and lower bounds
-                    if (temperature1 > 50) {
-                        temperature1 = 50;
-                    } else if (temperature1 < 10) {
-                        temperature1 = 10;
-                    }
-                    // Need a different variable to handle the conversion, because celsius value must be preserved
-                    double tempTemp1 = temperature1;
-                    // Stream for the screen
-                    std::ostringstream ss1;
-
-                    // Potential conversion to Fahrenheit
-                    if (unit == "F") {
-                        tempTemp1 = tempTemp1 * 9 / 5.0 + 32;
-                    }
-
-                    ss1 << "Sensor 1: " << std::fixed << std::setprecision(2) << tempTemp1 << " " << unit << "    ";
-                    screen.drawString(0, 0, ss1.str());
-                    temperature1Null = false;
-                } catch (const std::exception &e) {
-                    // If the sensor is supposed to be on, but no reading is found, the sensor has been unplugged
-                    screen.drawString(0, 0, "Sensor 1: Unplugged ");
-                    temperature1Null = true;
-                }
-            } else {
-                screen.drawString(0, 0, "Sensor 1: OFF       ");
-                temperature1Null = true;
+            if (!sensorsEnabled[i]) {
+                sample.status = samples::Status::Off;
+                history.push(sample);
+                continue;
             }
-            if (sensor2Enabled) {
-                try {
-                    temperature2 = readTemperature("/sys/bus/w1/devices/28-000007292a49");
-                    // Set upper and lower bounds
-                    if (temperature2 > 50) {
-                        temperature2 = 50;
-                    } else if (temperature2 < 10) {
-                        temperature2 = 10;
-                    }
-
-                    double tempTemp2 = temperature2;
-
-                    if (unit == "F") {
-                        tempTemp2 = tempTemp2 * 9 / 5.0 + 32;
-                    }
-
-                    std::ostringstream ss2;
-                    ss2 << "Sensor 2: " << std::fixed << std::setprecision(2) << tempTemp2 << " " << unit << "    ";
-                    screen.drawString(0, 8, ss2.str());
-                    temperature2Null = false;
-                } catch (const std::exception &e) {
-                    screen.drawString(0, 8, "Sensor 2: Unplugged ");
-                    temperature2Null = true;
-                }
-            } else {
-                screen.drawString(0, 8, "Sensor 2: OFF       ");
-                temperature2Null = true;
+
+            w1::Temperature reading = acquisition.temperature(i);
+            if (!reading.ok()) {
+                sample.status = reading.error == w1::ParseError::ReadFailed ? samples::Status::Unplugged : samples::Status::Invalid;
+                history.push(sample);
+                continue;
             }
 
-            // Update lastReadTime
-            lastReadTime = currentTime;
+            // Set upper and lower bounds
+            sample.status = samples::Status::Ok;
+            sample.milliCelsius = std::clamp(reading.milliCelsius, 10000, 50000);
+            history.push(sample);
+        }
+
+        dashboard.notify();
+        uploader.notify();
 
-            // Create JSON object to send to server
-            json json_data;
-            
-            // ALWAYS SEND TEMPERATURE IN CELSIUS- THE SERVER WILL HANDLE CONVERSIONS
-            if (temperature1Null) {
-                json_data["sensor1Temperature"] = nullptr;
-            } else {
-                json_data["sensor1Temperature"] = temperature1;
+        // The timings for the log, unless the main thread is reading the last ones right now
+        std::unique_lock<std::mutex> lock(lastCycleMutex, std::try_to_lock);
+        if (lock.owns_lock()) {
+            lastCycle.cycle = acquisition.lastCycle();
+            lastCycle.bulk = acquisition.lastBulk();
+            lastCycle.sensors = acquisition.size();
+            for (size_t i = 0; i < acquisition.size(); i++) {
+                lastCycle.status[i] = acquisition.reading(i).status;
+                lastCycle.elapsed[i] = acquisition.reading(i).elapsed;
+            }
+            lock.unlock();
+            samplerEvents.notify();
+        }
+    };
+
+    sampler.add(sampleTimer.fd(), EPOLLIN, [&](uint32_t) {
+        if (sampleTimer.consume() == 0) {
+            return;
+        }
+        auto start = timing::Monotonic::now();
+        jitter.record(start - deadlines.next());
+        sampleSensors(start);
+
+        // The next deadline stays on the grid however long this cycle took, overrun ones are skipped
+        sampleTimer.setAt(deadlines.advance(timing::Monotonic::now()));
+    });
+    sampler.add(samplerControl.fd(), EPOLLIN, [&](uint32_t) {
+        samplerControl.consume();
+
+        // Between cycles, so the new period applies from the deadline just served
+        unsigned int interval = samplerInterval.load();
+        if (interval != samplerPeriod) {
+            samplerPeriod = interval;
+            deadlines.setPeriod(std::chrono::milliseconds(samplerPeriod));
+            if (timerArmed) {
+                sampleTimer.setAt(deadlines.next());
             }
+        }
 
-            if (temperature2Null) {
-                json_data["sensor2Temperature"] = nullptr;
+        // Follow the power switch, sampling right away when it comes on
+        bool active = systemActive.load();
+        if (active != timerArmed) {
+            if (active) {
+                deadlines.start(timing::Monotonic::now());
+                sampleTimer.setAt(deadlines.next());
             } else {
-                json_data["sensor2Temperature"] = temperature2;
+                sampleTimer.disarm();
             }
+            timerArmed = active;
+        }
+    });
+    sampler.add(samplerStop.fd(), EPOLLIN, [&](uint32_t) {
+        sampler.stop();
+    });
 
-            auto res = client.Post("/temperatureData", json_data.dump(), "application/json");
+    // The cycle log and the overhead measurement, on the main thread
+    loop.add(samplerEvents.fd(), EPOLLIN, [&](uint32_t) {
+        samplerEvents.consume();
+        CycleLog cycle;
+        {
+            std::lock_guard<std::mutex> lock(lastCycleMutex);
+            cycle = lastCycle;
+        }
+        std::cout << "Cycle: " << toMillis(cycle.cycle) << " ms (bulk: " << toMillis(cycle.bulk) << " ms";
+        for (size_t i = 0; i < cycle.sensors; i++) {
+            std::cout << ", sensor " << i + 1 << ": " << toMillis(cycle.elapsed[i]) << " ms";
+        }
+        std::cout << ")" << std::endl;
+        measureOverhead(cycle);
+    });
+    // Without the uevent socket nothing reports a plugged in probe, so the buses are rescanned on a timer
+    event::Timer rescanTimer;
+    if (discovery.fd() >= 0) {
+        loop.add(discovery.fd(), EPOLLIN, [&](uint32_t) {
+            refreshSensors(false);
+        });
+    } else {
+        rescanTimer.setPeriod(w1::Discovery::FALLBACK_RESCAN);
+        loop.add(rescanTimer.fd(), EPOLLIN, [&](uint32_t) {
+            if (rescanTimer.consume() > 0) {
+                refreshSensors(true);
+            }
+        });
+    }
 
-            if (res) {
-                // Parse the JSON array
-                json j = json::parse(res->body);
+    // Loop wakeups spent while the system is off. Even an idle system adds some: switching off wakes the sampling
+    // thread to disarm its timer and lets a cycle in flight finish (its log, the dashboard going blank, a last
+    // upload), the uevent socket wakes the main loop for every uevent the kernel broadcasts, whatever the device
+    // (or the rescan timer every FALLBACK_RESCAN without it), and so does SIGUSR1. Anything beyond that is a leak
+    auto totalWakeups = [&]() {
+        return loop.wakeups() + sampler.wakeups() + dashboard.stage().wakeups() + uploader.stage().wakeups();
+    };
+    uint64_t offWakeups = 0;
+    uint64_t wakeupsAtOff = 0;
 
-                // bool sensor1Enabled = j[1].get<bool>();
-                // bool sensor2Enabled = j[2].get<bool>();
-                std::cout << "Response Status: " << res->status << std::endl;
-                std::cout << "Response Body: " << res->body << std::endl;
+    // Turns sampling, drawing and uploads on or off
+    auto setSystemActive = [&](bool active) {
+        systemActive.store(active);
+        dashboard.setActive(active);
+        samplerControl.notify();
+        std::cout << (active ? "System ON" : "System OFF") << std::endl;
+    };
 
-                // Check for change in units
-                if (j[0].get<std::string>() != unit) {
-                    unit = changeUnits(unit);
-                }
+    auto printStats = [&]() {
+        uint64_t wakeups = totalWakeups();
+        printPowerStats(wakeups, startTime, offWakeups + (systemActive ? 0 : wakeups - wakeupsAtOff));
+        std::cout << "Stage sample: " << cycleTime.count() << " cycles, " << toMillis(cycleTime.last()) << " ms last / "
+                  << toMillis(cycleTime.max()) << " ms max" << std::endl;
+        std::cout << "Sample jitter: p50 " << toMillis(jitter.percentile(0.5)) << " ms, p99 "
+                  << toMillis(jitter.percentile(0.99)) << " ms, max " << toMillis(jitter.max()) << " ms, "
+                  << deadlines.missed() << " deadlines missed" << std::endl;
+        printStageStats("display", dashboard.stage());
+        ssd1306::BusErrors displayErrors = dashboard.busErrors();
+        std::cout << "Display bus: " << displayErrors.failed << " failed transfers, " << displayErrors.retries
+                  << " retries, " << displayErrors.dropped << " dropped, " << displayErrors.reinits << " reinits"
+                  << std::endl;
+        printStageStats("upload", uploader.stage());
+    };
 
-                // Check for change in sensor 1 status
-                if (j[1].get<bool>() != sensor1Enabled) {
-                    buttonCallback(BUTTON_SENSOR1, lastPressTime1, sensor1Enabled);
-                }
+    // Applies the server's answer to the last upload
+    auto applyResponse = [&]() {
+        Uploader::Response res;
+        if (!uploader.takeResponse(res)) {
+            return;
+        }
+        if (!res.ok) {
+            std::cout << "Error: " << res.error << std::endl;
+            return;
+        }
+        // A reply that was in flight when the switch went off
+        if (!systemActive) {
+            return;
+        }
 
-                // Check for change in sensor 2 status
-                if (j[2].get<bool>() != sensor2Enabled) {
-                    buttonCallback(BUTTON_SENSOR2, lastPressTime2, sensor2Enabled);
-                }
+        // Parse the JSON array: [unit, sensor1Enabled, sensor2Enabled, ...]
+        json j = json::parse(res.body, nullptr, false);
+
+        std::cout << "Response Status: " << res.status << std::endl;
+        std::cout << "Response Body: " << res.body << std::endl;
+
+        if (!j.is_array() || j.empty() || !j[0].is_string()) {
+            return;
+        }
+
+        // Check for change in units
+        if (j[0].get<std::string>() != unit) {
+            unit = changeUnits(unit);
+            dashboard.setUnit(unit);
+        }
+
+        // Check for change in each sensor's status
+        for (size_t i = 0; i < MAX_SENSORS && i + 1 < j.size() && j[i + 1].is_boolean(); i++) {
+            if (j[i + 1].get<bool>() != sensorEnabled[i]) {
+                toggleSensor(i);
+            }
+        }
+        dashboard.notify();
+
+        // Resolution writes happen here, a new period reaches the sampling thread between cycles
+        if (j.size() > 1 && j.back().is_object()) {
+            applySettings(parseSettings(j.back()));
+        }
+    };
+
+    loop.add(buttons.fd(), EPOLLIN, [&](uint32_t) {
+        gpio::Event edge;
+        while (buttons.read(edge)) {
+            // Buttons do nothing while the system is off
+            if (!systemActive) {
+                continue;
+            }
+            size_t sensor = edge.line == BUTTON_SENSOR1 ? 0 : 1;
+            toggleSensor(sensor);
+            // Edge timestamps are on the same monotonic clock as everything else
+            std::cout << "Button " << sensor + 1 << " pressed at " << edge.timestampNs / 1000 << " us, handled "
+                      << (timing::nowNanos() - edge.timestampNs) / 1000 << " us later" << std::endl;
+        }
+        dashboard.notify();
+    });
+    loop.add(powerSwitch.fd(), EPOLLIN, [&](uint32_t) {
+        gpio::Event edge;
+        bool active = systemActive;
+        while (powerSwitch.read(edge)) {
+            active = edge.rising;
+        }
+        if (active == systemActive) {
+            return;
+        }
+        if (active) {
+            // Everything since switching off, minus the wakeup that turned the system back on
+            offWakeups += totalWakeups() - wakeupsAtOff - 1;
+        } else {
+            wakeupsAtOff = totalWakeups();
+        }
+        setSystemActive(active);
+    });
+    loop.add(uploadEvents.fd(), EPOLLIN, [&](uint32_t) {
+        uploadEvents.consume();
+        applyResponse();
+    });
+    loop.add(signals.fd(), EPOLLIN, [&](uint32_t) {
+        int signal;
+        while ((signal = signals.consume()) != 0) {
+            if (signal == SIGUSR1) {
+                printStats();
             } else {
-                std::cout << "Error: " << res.error() << std::endl;
+                loop.stop();
             }
         }
+    });
+
+    // Measurement mode: stop after a fixed time and report
+    event::Timer measureTimer;
+    if (measureSeconds > 0) {
+        measureTimer.set(std::chrono::seconds(measureSeconds), std::chrono::nanoseconds(0));
+        loop.add(measureTimer.fd(), EPOLLIN, [&](uint32_t) {
+            measureTimer.consume();
+            loop.stop();
+        });
     }
-}
\ No newline at end of file
+
+    // Sensors are assumed to start off; the sampling thread arms its tick once it sees the switch on
+    setSystemActive(systemActive);
+    std::thread samplerThread([&] {
+        if (realtime.enabled()) {
+            int err = rt::enter(realtime);
+            if (err < 0) {
+                std::cerr << "Could not apply the real-time profile: " << std::strerror(-err) << std::endl;
+            } else {
+                std::cout << "Sampling with SCHED_FIFO priority " << realtime.priority << " (0: normal scheduler), cpu "
+                          << realtime.cpu << " (-1: any)" << std::endl;
+            }
+        }
+        sampler.run();
+    });
+
+    // The main thread sleeps in epoll_wait between control events
+    loop.run();
+
+    samplerStop.notify();
+    samplerThread.join();
+    printStats();
+    return 0;
+}